@@ -0,0 +1,488 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "reservoir_sampler.h"
+#include "reservoir_sampler_linear.h"
+#include "reservoir_sampler_linear_static.h"
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_scheduled.h"
+#include "reservoir_sampler_static.h"
+#include "reservoir_sampler_weighted.h"
+#include "reservoir_sampler_weighted_packed.h"
+#include "reservoir_sampler_weighted_static.h"
+
+namespace
+{
+	size_t gRandomCallsCount = 0;
+	size_t gConstructionsCount = 0;
+	size_t gAssignmentsCount = 0;
+
+	// wraps a generator to count the calls to it
+	template<typename URNG>
+	class CountingURNG
+	{
+	public:
+		using result_type = typename URNG::result_type;
+
+	public:
+		explicit CountingURNG(uint64_t seed)
+			: mRand(static_cast<typename URNG::result_type>(seed))
+		{}
+
+		static constexpr result_type min() { return URNG::min(); }
+		static constexpr result_type max() { return URNG::max(); }
+
+		result_type operator()()
+		{
+			++gRandomCallsCount;
+			return mRand();
+		}
+
+	private:
+		URNG mRand;
+	};
+
+	struct Pod64
+	{
+		std::array<uint64_t, 8> data;
+	};
+
+	// the elements are created from their index in the stream
+	template<typename T>
+	T makeElement(int index);
+
+	template<>
+	int makeElement<int>(int index)
+	{
+		return index;
+	}
+
+	template<>
+	Pod64 makeElement<Pod64>(int index)
+	{
+		Pod64 result{};
+		result.data.fill(static_cast<uint64_t>(index));
+		return result;
+	}
+
+	template<>
+	std::string makeElement<std::string>(int index)
+	{
+		// long enough to not fit into the small string buffer
+		return std::string(32, static_cast<char>('a' + index % 26));
+	}
+
+	// counts constructions and assignments of the stored elements
+	template<typename T>
+	struct Counted
+	{
+		explicit Counted(int index)
+			: value(makeElement<T>(index))
+		{
+			++gConstructionsCount;
+		}
+
+		Counted(const Counted& other)
+			: value(other.value)
+		{
+			++gConstructionsCount;
+		}
+
+		Counted(Counted&& other) noexcept
+			: value(std::move(other.value))
+		{
+			++gConstructionsCount;
+		}
+
+		Counted& operator=(const Counted& other)
+		{
+			value = other.value;
+			++gAssignmentsCount;
+			return *this;
+		}
+
+		Counted& operator=(Counted&& other) noexcept
+		{
+			value = std::move(other.value);
+			++gAssignmentsCount;
+			return *this;
+		}
+
+		T value;
+	};
+
+	enum class Mode
+	{
+		SampleElement,
+		SampleElementEmplace,
+		// sampleRange for uniform samplers, willNextElementBeConsidered/skipNextElement for weighted
+		Skip,
+	};
+
+	template<typename T>
+	std::vector<Counted<T>> makeStream(size_t size)
+	{
+		std::vector<Counted<T>> result;
+		result.reserve(size);
+		for (size_t i = 0; i < size; ++i)
+		{
+			result.emplace_back(static_cast<int>(i));
+		}
+		return result;
+	}
+
+	float makeWeight(size_t index)
+	{
+		return static_cast<float>(index % 16 + 1);
+	}
+
+	void resetCounters()
+	{
+		gRandomCallsCount = 0;
+		gConstructionsCount = 0;
+		gAssignmentsCount = 0;
+	}
+
+	void reportCounters(benchmark::State& state, size_t streamSize)
+	{
+		state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * streamSize));
+		state.counters["time_per_element"] = benchmark::Counter(static_cast<double>(state.iterations() * streamSize), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+		state.counters["rand_calls"] = benchmark::Counter(static_cast<double>(gRandomCallsCount), benchmark::Counter::kAvgIterations);
+		state.counters["constructions"] = benchmark::Counter(static_cast<double>(gConstructionsCount), benchmark::Counter::kAvgIterations);
+		state.counters["assignments"] = benchmark::Counter(static_cast<double>(gAssignmentsCount), benchmark::Counter::kAvgIterations);
+	}
+
+	// feeds the stream to a uniform sampler (ReservoirSampler or ReservoirSamplerStatic)
+	template<Mode SamplingMode, typename Sampler, typename T>
+	void feedUniform(Sampler& sampler, const std::vector<Counted<T>>& stream)
+	{
+		if constexpr (SamplingMode == Mode::SampleElement)
+		{
+			for (const Counted<T>& element : stream)
+			{
+				sampler.sampleElement(element);
+			}
+		}
+		else if constexpr (SamplingMode == Mode::SampleElementEmplace)
+		{
+			for (size_t i = 0; i < stream.size(); ++i)
+			{
+				sampler.sampleElementEmplace(static_cast<int>(i));
+			}
+		}
+		else
+		{
+			sampler.sampleRange(stream.begin(), stream.end());
+		}
+	}
+
+	// feeds the stream to a weighted sampler (ReservoirSamplerWeighted or ReservoirSamplerWeightedStatic)
+	template<Mode SamplingMode, typename Sampler, typename T>
+	void feedWeighted(Sampler& sampler, const std::vector<Counted<T>>& stream)
+	{
+		for (size_t i = 0; i < stream.size(); ++i)
+		{
+			const float weight = makeWeight(i);
+			if constexpr (SamplingMode == Mode::SampleElement)
+			{
+				sampler.sampleElement(weight, stream[i]);
+			}
+			else if constexpr (SamplingMode == Mode::SampleElementEmplace)
+			{
+				sampler.sampleElementEmplace(weight, static_cast<int>(i));
+			}
+			else
+			{
+				if (sampler.willNextElementBeConsidered(weight))
+				{
+					sampler.sampleElement(weight, stream[i]);
+				}
+				else
+				{
+					sampler.skipNextElement(weight);
+				}
+			}
+		}
+	}
+
+	// arguments: k, n
+	template<typename T, typename URNG, Mode SamplingMode>
+	void BM_ReservoirSampler(benchmark::State& state)
+	{
+		const size_t samplesCount = static_cast<size_t>(state.range(0));
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(1)));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<URNG> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSampler<Counted<T>, CountingURNG<URNG>&> sampler{samplesCount, rand};
+			feedUniform<SamplingMode>(sampler, stream);
+			benchmark::DoNotOptimize(sampler.getResult().data);
+		}
+		reportCounters(state, stream.size());
+	}
+
+	// arguments: k, n
+	// the schedule is refilled on reset, which is not measured
+	template<typename T, typename URNG, Mode SamplingMode>
+	void BM_ReservoirSamplerScheduled(benchmark::State& state)
+	{
+		const size_t samplesCount = static_cast<size_t>(state.range(0));
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(1)));
+		CountingURNG<URNG> rand{42};
+		ReservoirSamplerScheduled<Counted<T>, CountingURNG<URNG>&> sampler{samplesCount, 1024, rand};
+		resetCounters();
+		for (auto _ : state)
+		{
+			feedUniform<SamplingMode>(sampler, stream);
+			benchmark::DoNotOptimize(sampler.getResult().data);
+			state.PauseTiming();
+			sampler.reset();
+			state.ResumeTiming();
+		}
+		reportCounters(state, stream.size());
+	}
+
+	// arguments: n
+	template<typename T, size_t SamplesCount, typename URNG, Mode SamplingMode>
+	void BM_ReservoirSamplerStatic(benchmark::State& state)
+	{
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(0)));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<URNG> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSamplerStatic<Counted<T>, SamplesCount, CountingURNG<URNG>&> sampler{rand};
+			feedUniform<SamplingMode>(sampler, stream);
+			benchmark::DoNotOptimize(sampler.getResult().data);
+		}
+		reportCounters(state, stream.size());
+	}
+
+	// arguments: k, n
+	template<typename T, typename URNG, Mode SamplingMode>
+	void BM_ReservoirSamplerWeighted(benchmark::State& state)
+	{
+		const size_t samplesCount = static_cast<size_t>(state.range(0));
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(1)));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<URNG> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSamplerWeighted<Counted<T>, float, CountingURNG<URNG>&> sampler{samplesCount, rand};
+			feedWeighted<SamplingMode>(sampler, stream);
+			benchmark::DoNotOptimize(sampler.getResult().data);
+		}
+		reportCounters(state, stream.size());
+	}
+
+	// arguments: k, n
+	template<typename T, typename URNG>
+	void BM_ReservoirSamplerWeightedBatch(benchmark::State& state)
+	{
+		const size_t samplesCount = static_cast<size_t>(state.range(0));
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(1)));
+		std::vector<float> weights(stream.size());
+		for (size_t i = 0; i < weights.size(); ++i)
+		{
+			weights[i] = makeWeight(i);
+		}
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<URNG> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSamplerWeighted<Counted<T>, float, CountingURNG<URNG>&> sampler{samplesCount, rand};
+			sampler.sampleWeightedBatch(weights.data(), weights.size(), [&stream](size_t index) -> const Counted<T>& { return stream[index]; });
+			benchmark::DoNotOptimize(sampler.getResult().data);
+		}
+		reportCounters(state, stream.size());
+	}
+
+	// arguments: k, n
+	template<typename HeapPolicy>
+	void BM_ReservoirSamplerWeightedHeap(benchmark::State& state)
+	{
+		const size_t samplesCount = static_cast<size_t>(state.range(0));
+		const std::vector<Counted<int>> stream = makeStream<int>(static_cast<size_t>(state.range(1)));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<std::mt19937> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSamplerWeighted<Counted<int>, float, CountingURNG<std::mt19937>&, float, ReservoirSamplerNoStats, std::allocator<std::byte>, HeapPolicy> sampler{samplesCount, rand};
+			feedWeighted<Mode::SampleElement>(sampler, stream);
+			benchmark::DoNotOptimize(sampler.getResult().data);
+		}
+		reportCounters(state, stream.size());
+	}
+
+	using WeightedIdsSampler = ReservoirSamplerWeighted<uint32_t, float, CountingURNG<std::mt19937>&>;
+	template<typename HeapPolicy>
+	using WeightedPackedIdsSampler = ReservoirSamplerWeightedPacked<uint32_t, float, CountingURNG<std::mt19937>&, float, ReservoirSamplerNoStats, HeapPolicy>;
+
+	// arguments: k, n
+	// small trivially copyable elements, to compare the separate elements array with ReservoirSamplerWeightedPacked
+	template<typename Sampler>
+	void BM_ReservoirSamplerWeightedIds(benchmark::State& state)
+	{
+		const size_t samplesCount = static_cast<size_t>(state.range(0));
+		const size_t streamSize = static_cast<size_t>(state.range(1));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<std::mt19937> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			Sampler sampler{samplesCount, rand};
+			for (size_t i = 0; i < streamSize; ++i)
+			{
+				sampler.sampleElement(makeWeight(i), static_cast<uint32_t>(i));
+			}
+			benchmark::DoNotOptimize(sampler.getResultSize());
+		}
+		reportCounters(state, streamSize);
+	}
+
+	// arguments: n
+	template<typename T, size_t SamplesCount, typename URNG, Mode SamplingMode>
+	void BM_ReservoirSamplerWeightedStatic(benchmark::State& state)
+	{
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(0)));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<URNG> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSamplerWeightedStatic<Counted<T>, SamplesCount, float, CountingURNG<URNG>&> sampler{rand};
+			feedWeighted<SamplingMode>(sampler, stream);
+			benchmark::DoNotOptimize(sampler.getResult().data);
+		}
+		reportCounters(state, stream.size());
+	}
+
+	// arguments: n
+	template<typename T, typename URNG, Mode SamplingMode>
+	void BM_ReservoirSamplerLinear(benchmark::State& state)
+	{
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(0)));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<URNG> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSamplerLinear<Counted<T>, unsigned int, CountingURNG<URNG>&> sampler{rand};
+			for (size_t i = 0; i < stream.size(); ++i)
+			{
+				const unsigned int weight = static_cast<unsigned int>(i % 16 + 1);
+				if constexpr (SamplingMode == Mode::SampleElementEmplace)
+				{
+					sampler.sampleElementEmplace(weight, static_cast<int>(i));
+				}
+				else
+				{
+					sampler.sampleElement(weight, stream[i]);
+				}
+			}
+			benchmark::DoNotOptimize(sampler.getResult());
+		}
+		reportCounters(state, stream.size());
+	}
+
+	// arguments: n
+	template<typename T, size_t SamplesCount, typename URNG, Mode SamplingMode>
+	void BM_ReservoirSamplerLinearStatic(benchmark::State& state)
+	{
+		const std::vector<Counted<T>> stream = makeStream<T>(static_cast<size_t>(state.range(0)));
+		// the generator is passed by reference to not measure its construction
+		CountingURNG<URNG> rand{42};
+		resetCounters();
+		for (auto _ : state)
+		{
+			ReservoirSamplerLinearStatic<Counted<T>, SamplesCount, float, CountingURNG<URNG>&> sampler{rand};
+			feedWeighted<SamplingMode>(sampler, stream);
+			benchmark::DoNotOptimize(sampler.getResult().data);
+		}
+		reportCounters(state, stream.size());
+	}
+
+	using Xoshiro = ReservoirSamplerUtils::Xoshiro256StarStar;
+	using Pcg = ReservoirSamplerUtils::Pcg32;
+	using Philox = ReservoirSamplerUtils::Philox4x32;
+
+	void DynamicArguments(benchmark::internal::Benchmark* benchmark)
+	{
+		benchmark->ArgsProduct({{1, 10, 100, 1000}, {100, 10000, 1000000}})->ArgNames({"k", "n"});
+	}
+
+	void StaticArguments(benchmark::internal::Benchmark* benchmark)
+	{
+		benchmark->ArgsProduct({{10, 100, 10000, 1000000}})->ArgNames({"n"});
+	}
+
+	void LargeHeapArguments(benchmark::internal::Benchmark* benchmark)
+	{
+		benchmark->ArgsProduct({{1000, 100000}, {10000000}})->ArgNames({"k", "n"});
+	}
+
+	void ShortStreamArguments(benchmark::internal::Benchmark* benchmark)
+	{
+		benchmark->ArgsProduct({{10, 30, 100, 300, 1000}})->ArgNames({"n"});
+	}
+}
+
+#define RESERVOIR_SAMPLER_BENCHMARKS_FOR_TYPE(T) \
+	BENCHMARK_TEMPLATE(BM_ReservoirSampler, T, std::mt19937, Mode::SampleElement)->Apply(DynamicArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSampler, T, std::mt19937, Mode::SampleElementEmplace)->Apply(DynamicArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSampler, T, std::mt19937, Mode::Skip)->Apply(DynamicArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerStatic, T, 1, std::mt19937, Mode::SampleElement)->Apply(StaticArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerStatic, T, 10, std::mt19937, Mode::SampleElement)->Apply(StaticArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerStatic, T, 10, std::mt19937, Mode::SampleElementEmplace)->Apply(StaticArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerStatic, T, 10, std::mt19937, Mode::Skip)->Apply(StaticArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeighted, T, std::mt19937, Mode::SampleElement)->Apply(DynamicArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeighted, T, std::mt19937, Mode::SampleElementEmplace)->Apply(DynamicArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeighted, T, std::mt19937, Mode::Skip)->Apply(DynamicArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedBatch, T, std::mt19937)->Apply(DynamicArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedStatic, T, 1, std::mt19937, Mode::SampleElement)->Apply(StaticArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedStatic, T, 10, std::mt19937, Mode::SampleElement)->Apply(StaticArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedStatic, T, 10, std::mt19937, Mode::SampleElementEmplace)->Apply(StaticArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedStatic, T, 1, std::mt19937, Mode::SampleElement)->Apply(ShortStreamArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerLinear, T, std::mt19937, Mode::SampleElement)->Apply(ShortStreamArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerLinear, T, std::mt19937, Mode::SampleElementEmplace)->Apply(ShortStreamArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedStatic, T, 3, std::mt19937, Mode::SampleElement)->Apply(ShortStreamArguments); \
+	BENCHMARK_TEMPLATE(BM_ReservoirSamplerLinearStatic, T, 3, std::mt19937, Mode::SampleElement)->Apply(ShortStreamArguments)
+
+RESERVOIR_SAMPLER_BENCHMARKS_FOR_TYPE(int);
+RESERVOIR_SAMPLER_BENCHMARKS_FOR_TYPE(Pod64);
+RESERVOIR_SAMPLER_BENCHMARKS_FOR_TYPE(std::string);
+
+// comparison of the random generators
+BENCHMARK_TEMPLATE(BM_ReservoirSampler, int, Xoshiro, Mode::SampleElement)->Apply(DynamicArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSampler, int, Pcg, Mode::SampleElement)->Apply(DynamicArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSampler, int, Philox, Mode::SampleElement)->Apply(DynamicArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerStatic, int, 10, Xoshiro, Mode::SampleElement)->Apply(StaticArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerStatic, int, 10, Pcg, Mode::SampleElement)->Apply(StaticArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeighted, int, Xoshiro, Mode::SampleElement)->Apply(DynamicArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeighted, int, Pcg, Mode::SampleElement)->Apply(DynamicArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerLinear, int, Xoshiro, Mode::SampleElement)->Apply(ShortStreamArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerLinear, int, Pcg, Mode::SampleElement)->Apply(ShortStreamArguments);
+
+// precomputed jumps
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerScheduled, int, std::mt19937, Mode::SampleElement)->Apply(DynamicArguments);
+
+// comparison of the heap layouts for big k
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedHeap, ReservoirSamplerBinaryHeap)->Apply(LargeHeapArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedHeap, ReservoirSamplerHeap<2, uint32_t>)->Apply(LargeHeapArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedHeap, ReservoirSamplerHeap<4, uint32_t>)->Apply(LargeHeapArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedHeap, ReservoirSamplerHeap<8, uint32_t>)->Apply(LargeHeapArguments);
+
+// elements stored next to the priorities in the heap
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedIds, WeightedIdsSampler)->Apply(LargeHeapArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedIds, WeightedPackedIdsSampler<ReservoirSamplerBinaryHeap>)->Apply(LargeHeapArguments);
+BENCHMARK_TEMPLATE(BM_ReservoirSamplerWeightedIds, WeightedPackedIdsSampler<ReservoirSamplerHeap<4, uint32_t>>)->Apply(LargeHeapArguments);
@@ -24,15 +24,26 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <random>
 #include <type_traits>
 #include <vector>
 
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_stats.h"
+
 // ReservoirSampler implements Algorithm L for reservoir sampling
 // https://en.wikipedia.org/wiki/Reservoir_sampling#Optimal:_Algorithm_L
-template<typename T, typename URNG = std::mt19937, typename RandType = float>
-class ReservoirSampler
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+// Allocator is used to allocate the storage for the elements (e.g. std::pmr::polymorphic_allocator<std::byte>)
+template<typename T, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats, typename Allocator = std::allocator<std::byte>>
+class ReservoirSampler : private StatsPolicy
 {
 public:
 	// C++17 doesn't support std::span, so we can do this instead
@@ -53,58 +64,91 @@ public:
 	};
 
 public:
+	template<typename URNG_T = URNG, typename = std::enable_if_t<std::is_constructible_v<URNG, URNG_T>>>
+	explicit ReservoirSampler(size_t samplesCount, URNG_T&& rand = URNG{std::random_device{}()}, const Allocator& allocator = Allocator())
+		: mSamplesCount(samplesCount)
+		, mRand(std::forward<URNG_T>(rand))
+		, mAllocator(allocator)
+	{
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		assert(samplesCount > 0);
+	}
+
+	// constructs the sampler over storage provided by the caller instead of allocating it
+	// the storage should be at least getRequiredStorageSize(samplesCount) bytes, be aligned to StorageAlignment and outlive the sampler
 	template<typename URNG_T = URNG>
-	explicit ReservoirSampler(size_t samplesCount, URNG_T&& rand = std::mt19937{std::random_device{}()})
+	ReservoirSampler(size_t samplesCount, void* storage, URNG_T&& rand = URNG{std::random_device{}()})
 		: mSamplesCount(samplesCount)
 		, mRand(std::forward<URNG_T>(rand))
+		, mElements(static_cast<T*>(storage))
+		, mData(storage)
+		, mHasExternalStorage(true)
 	{
 		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
 		assert(samplesCount > 0);
+		assert(storage != nullptr && reinterpret_cast<std::uintptr_t>(storage) % StorageAlignment == 0);
 	}
 
 	~ReservoirSampler()
 	{
 		reset();
-
-#ifdef _MSC_VER
-		_aligned_free(mData);
-#else
-		std::free(mData);
-#endif
+		freeData();
 	}
 
 	ReservoirSampler(const ReservoirSampler& other)
-		: mSamplesCount(other.mSamplesCount)
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
 		, mIndexesToJumpOver(other.mIndexesToJumpOver)
 		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
+		, mSeenElementsCount(other.mSeenElementsCount)
+		, mConstructedElementsCount(other.mFilledElementsCount)
+		, mAllocator(std::allocator_traits<BlockAllocator>::select_on_container_copy_construction(other.mAllocator))
 	{
 		if (other.mData)
 		{
 			allocateData();
 
-			for (size_t i = 0; i < mFilledElementsCount; ++i)
+			// trivially copyable elements are copied as a whole block
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				std::memcpy(mElements, other.mElements, sizeof(T)*mFilledElementsCount);
+				for (size_t i = 0; i < mFilledElementsCount; ++i)
+				{
+					this->onConstruction();
+				}
+			}
+			else
 			{
-				new (mElements + i) T(other.mElements[i]);
+				for (size_t i = 0; i < mFilledElementsCount; ++i)
+				{
+					new (mElements + i) T(other.mElements[i]);
+					this->onConstruction();
+				}
 			}
 		}
 	}
 
 	ReservoirSampler(ReservoirSampler&& other) noexcept
-		: mSamplesCount(other.mSamplesCount)
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
 		, mIndexesToJumpOver(other.mIndexesToJumpOver)
 		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
+		, mSeenElementsCount(other.mSeenElementsCount)
+		, mConstructedElementsCount(other.mConstructedElementsCount)
+		, mAllocator(std::move(other.mAllocator))
 		, mElements(other.mElements)
 		, mData(other.mData)
+		, mHasExternalStorage(other.mHasExternalStorage)
 	{
 		other.mIndexesToJumpOver = 0;
 		other.mWeightJumpOver = {};
 		other.mFilledElementsCount = 0;
+		other.mSeenElementsCount = 0;
+		other.mConstructedElementsCount = 0;
 		other.mElements = nullptr;
 		other.mData = nullptr;
 	}
@@ -129,6 +173,64 @@ public:
 		emplace<false>(std::forward<Args>(arguments)...);
 	}
 
+	// samples all the elements of the range, the elements that are not going to be considered are not accessed
+	// with random access iterators the skipped elements are jumped over in constant time
+	template<typename It>
+	void sampleRange(It first, It last)
+	{
+		sampleRange(first, last, [](auto&& element) -> decltype(auto) { return std::forward<decltype(element)>(element); });
+	}
+
+	// same as above, but the stored elements are produced by projection (e.g. a pointer to member)
+	// the projection is called only for the elements that are going to be considered
+	template<typename It, typename Projection>
+	void sampleRange(It first, It last, Projection&& projection)
+	{
+		if constexpr (!std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>)
+		{
+			// single-pass iterators can't be measured in advance, so they are walked one element at a time
+			for (; first != last; ++first)
+			{
+				if (willNextElementBeConsidered())
+				{
+					emplace<true>(std::invoke(projection, *first));
+				}
+				else
+				{
+					skipNextElement();
+				}
+			}
+		}
+		else
+		{
+			size_t elementsLeft = static_cast<size_t>(std::distance(first, last));
+			while (elementsLeft > 0)
+			{
+				if (mIndexesToJumpOver == 0)
+				{
+					emplace<true>(std::invoke(projection, *first));
+					++first;
+					--elementsLeft;
+				}
+				else
+				{
+					const size_t skipAmount = std::min(mIndexesToJumpOver, elementsLeft);
+					std::advance(first, static_cast<typename std::iterator_traits<It>::difference_type>(skipAmount));
+					elementsLeft -= skipAmount;
+					mIndexesToJumpOver -= skipAmount;
+					mSeenElementsCount += skipAmount;
+					this->onElementsSeen(skipAmount);
+					this->onElementsSkipped(skipAmount);
+				}
+			}
+		}
+	}
+
+	void sampleBatch(const T* elements, size_t count)
+	{
+		sampleRange(elements, elements + count);
+	}
+
 	ResultSpan getResult() const
 	{
 		return ResultSpan(mElements, mFilledElementsCount);
@@ -136,9 +238,8 @@ public:
 
 	std::vector<T> consumeResult()
 	{
-		std::vector<T> result;
-		result.reserve(mFilledElementsCount);
-		std::move(mElements, mElements + mFilledElementsCount, std::back_inserter(result));
+		// constructing from a range of move iterators copies trivially copyable elements as a whole block
+		std::vector<T> result(std::make_move_iterator(mElements), std::make_move_iterator(mElements + mFilledElementsCount));
 
 		reset();
 
@@ -157,13 +258,22 @@ public:
 	// fully resets the state and cleans all the stored data, allowing to be reused for a new sampling
 	void reset()
 	{
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		for (size_t i = 0; i < mConstructedElementsCount; ++i)
 		{
 			mElements[i].~T();
 		}
+		mConstructedElementsCount = 0;
+		resetKeepingElements();
+	}
+
+	// resets the state of the sampling, but keeps the stored elements and the storage
+	// the next sampling will assign to the kept elements instead of constructing new ones, they are destroyed on reset or destruction
+	void resetKeepingElements()
+	{
 		mIndexesToJumpOver = 0;
 		mWeightJumpOver = {};
 		mFilledElementsCount = 0;
+		mSeenElementsCount = 0;
 	}
 
 	// optionally use this function in combination with skipNextElement in case creation of an object is expensive
@@ -178,6 +288,9 @@ public:
 	{
 		assert(!willNextElementBeConsidered());
 		--mIndexesToJumpOver;
+		++mSeenElementsCount;
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
 	}
 
 	// optionally use in case in combination with jumpAhead to skip elements that are not going to be considered
@@ -193,21 +306,276 @@ public:
 	{
 		assert(elementsToJumpOver <= mIndexesToJumpOver);
 		mIndexesToJumpOver -= elementsToJumpOver;
+		mSeenElementsCount += elementsToJumpOver;
+		this->onElementsSeen(elementsToJumpOver);
+		this->onElementsSkipped(elementsToJumpOver);
+	}
+
+	// amount of elements that went through the sampler since the last reset, including the skipped ones
+	size_t getSeenElementsCount() const { return mSeenElementsCount; }
+
+	// merges the result of another sampler into this one, so the result is as if all the elements
+	// that went through the other sampler also went through this one
+	// can be used to sample a stream in parallel and then merge the results, both samplers should have the same samples count
+	void merge(const ReservoirSampler& other)
+	{
+		assert(this != &other);
+		assert(mSamplesCount == other.mSamplesCount);
+
+		if (other.mFilledElementsCount == 0)
+		{
+			return;
+		}
+
+		if (mData == nullptr)
+		{
+			allocateData();
+		}
+
+		const size_t totalSeenCount = mSeenElementsCount + other.mSeenElementsCount;
+		const size_t resultSize = std::min(mSamplesCount, totalSeenCount);
+
+		// each of the result elements comes from one of the two streams with the chances proportional
+		// to the amount of not yet taken elements of that stream (hypergeometric distribution)
+		size_t thisElementsToKeep = 0;
+		{
+			size_t thisSeenLeft = mSeenElementsCount;
+			size_t otherSeenLeft = other.mSeenElementsCount;
+			for (size_t i = 0; i < resultSize; ++i)
+			{
+				if (generateBounded(thisSeenLeft + otherSeenLeft) < thisSeenLeft)
+				{
+					++thisElementsToKeep;
+					--thisSeenLeft;
+				}
+				else
+				{
+					--otherSeenLeft;
+				}
+			}
+		}
+
+		// selection sampling to pick random elements of the other sampler without replacement
+		size_t otherElementsToTake = resultSize - thisElementsToKeep;
+		size_t otherElementsLeft = other.mFilledElementsCount;
+		size_t otherIdx = 0;
+		const auto takeNextOtherElement = [&](size_t pos) {
+			while (generateBounded(otherElementsLeft) >= otherElementsToTake)
+			{
+				++otherIdx;
+				--otherElementsLeft;
+			}
+			setElement<true>(pos, other.mElements[otherIdx]);
+			++otherIdx;
+			--otherElementsLeft;
+			--otherElementsToTake;
+		};
+
+		// the amount of removed elements never exceeds the amount of the elements taken from the other sampler
+		// so we can fill the gaps in place without moving the elements of this sampler
+		size_t thisElementsLeft = mFilledElementsCount;
+		size_t thisElementsToKeepLeft = thisElementsToKeep;
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			if (generateBounded(thisElementsLeft) < thisElementsToKeepLeft)
+			{
+				--thisElementsToKeepLeft;
+			}
+			else
+			{
+				takeNextOtherElement(i);
+			}
+			--thisElementsLeft;
+		}
+
+		for (size_t i = mFilledElementsCount; i < resultSize; ++i)
+		{
+			takeNextOtherElement(i);
+		}
+
+		mFilledElementsCount = resultSize;
+		mSeenElementsCount = totalSeenCount;
+
+		if (mFilledElementsCount == mSamplesCount)
+		{
+			// the weight is distributed as k-th smallest of n uniform random values, which is Beta(k, n - k + 1)
+			const double x = std::gamma_distribution<double>(static_cast<double>(mSamplesCount))(mRand);
+			const double y = std::gamma_distribution<double>(static_cast<double>(totalSeenCount - mSamplesCount + 1))(mRand);
+			this->onRandomCall();
+			this->onRandomCall();
+			mWeightJumpOver = static_cast<RandType>(x / (x + y));
+			mIndexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), mWeightJumpOver);
+		}
+		else
+		{
+			mIndexesToJumpOver = 0;
+			mWeightJumpOver = {};
+		}
 	}
 
 	// optionally use if you don't want to delay the memory allocation to the moment of adding the first element
 	void allocateData()
 	{
 		assert(mData == nullptr);
-#ifdef _MSC_VER // MSVC doesn't support std::aligned_alloc
-		mData = _aligned_malloc(sizeof(T) * mSamplesCount, std::alignment_of_v<T>);
-#else
-		mData = std::aligned_alloc(std::alignment_of_v<T>, sizeof(T)*mSamplesCount);
-#endif
+		mData = std::allocator_traits<BlockAllocator>::allocate(mAllocator, getBlocksCount(mSamplesCount));
 		mElements = reinterpret_cast<T*>(mData);
+		this->onAllocation();
+	}
+
+	static constexpr size_t StorageAlignment = std::alignment_of_v<T>;
+
+	// size in bytes of the storage that should be provided to the constructor taking external storage
+	static constexpr size_t getRequiredStorageSize(size_t samplesCount)
+	{
+		return sizeof(T)*samplesCount;
+	}
+
+	// writes the full state of the sampler including the state of the random generator and the elements to the end of buffer
+	// Codec defines how the elements are written, the default one copies the bytes of trivially copyable types
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Uniform, mSamplesCount);
+		writer.write(mIndexesToJumpOver);
+		writer.write(mWeightJumpOver);
+		writer.write(mSeenElementsCount);
+		ReservoirSamplerUtils::writeRand(writer, mRand);
+		writer.write(mFilledElementsCount);
+		ReservoirSamplerUtils::writeElements(writer, mElements, mFilledElementsCount, codec);
+	}
+
+	// restores the state written by serialize, the sampler should have the same samples count
+	// returns false if the data can't be read, in this case the sampler is left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		size_t indexesToJumpOver = 0;
+		RandType weightJumpOver {};
+		size_t seenElementsCount = 0;
+		size_t filledElementsCount = 0;
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Uniform, mSamplesCount)
+			|| !reader.read(indexesToJumpOver)
+			|| !reader.read(weightJumpOver)
+			|| !reader.read(seenElementsCount)
+			|| !ReservoirSamplerUtils::readRand(reader, mRand)
+			|| !reader.read(filledElementsCount)
+			|| filledElementsCount > mSamplesCount)
+		{
+			return false;
+		}
+
+		if (filledElementsCount > 0 && mData == nullptr)
+		{
+			allocateData();
+		}
+
+		mFilledElementsCount = ReservoirSamplerUtils::readElements(reader, mElements, filledElementsCount, codec);
+		mConstructedElementsCount = mFilledElementsCount;
+		if (mFilledElementsCount != filledElementsCount)
+		{
+			reset();
+			return false;
+		}
+
+		mIndexesToJumpOver = indexesToJumpOver;
+		mWeightJumpOver = weightJumpOver;
+		mSeenElementsCount = seenElementsCount;
+		return true;
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+private:
+	// the allocator is rebound to blocks with the alignment of T, so the allocated memory is always properly aligned
+	struct alignas(StorageAlignment) AllocationBlock
+	{
+		std::byte data[StorageAlignment];
+	};
+
+	using BlockAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<AllocationBlock>;
+
+public:
+	// holds a result taken from a sampler with swapResult
+	class ResultBuffer
+	{
+	public:
+		explicit ResultBuffer(const Allocator& allocator = Allocator())
+			: mAllocator(allocator)
+		{}
+
+		~ResultBuffer()
+		{
+			for (size_t i = 0; i < mConstructedElementsCount; ++i)
+			{
+				mElements[i].~T();
+			}
+			if (mData != nullptr && !mHasExternalStorage)
+			{
+				std::allocator_traits<BlockAllocator>::deallocate(mAllocator, static_cast<AllocationBlock*>(mData), getBlocksCount(mSamplesCount));
+			}
+		}
+
+		ResultBuffer(const ResultBuffer&) = delete;
+		ResultBuffer& operator=(const ResultBuffer&) = delete;
+
+		ResultSpan getResult() const
+		{
+			return ResultSpan(mElements, mResultSize);
+		}
+
+		size_t getResultSize() const { return mResultSize; }
+
+	private:
+		friend class ReservoirSampler;
+
+		BlockAllocator mAllocator;
+		T* mElements = nullptr;
+		void* mData = nullptr;
+		size_t mResultSize = 0;
+		size_t mConstructedElementsCount = 0;
+		size_t mSamplesCount = 0;
+		bool mHasExternalStorage = false;
+	};
+
+	// gives the result to buffer without moving the elements and resets the sampler
+	// the sampler takes the storage that the buffer held before (if any) and assigns to its elements instead of constructing new ones
+	// so swapping with the same buffer every sampling round doesn't allocate, construct or destroy elements in the steady state
+	// the buffer should be created with an allocator equal to the allocator of the sampler
+	void swapResult(ResultBuffer& buffer)
+	{
+		assert(buffer.mData == nullptr || buffer.mSamplesCount == mSamplesCount);
+		assert(buffer.mAllocator == mAllocator);
+
+		std::swap(mElements, buffer.mElements);
+		std::swap(mData, buffer.mData);
+		std::swap(mHasExternalStorage, buffer.mHasExternalStorage);
+		std::swap(mConstructedElementsCount, buffer.mConstructedElementsCount);
+		buffer.mResultSize = mFilledElementsCount;
+		buffer.mSamplesCount = mSamplesCount;
+
+		resetKeepingElements();
 	}
 
 private:
+	static size_t getBlocksCount(size_t samplesCount)
+	{
+		return (getRequiredStorageSize(samplesCount) + sizeof(AllocationBlock) - 1) / sizeof(AllocationBlock);
+	}
+
+	void freeData()
+	{
+		if (mData != nullptr && !mHasExternalStorage)
+		{
+			std::allocator_traits<BlockAllocator>::deallocate(mAllocator, static_cast<AllocationBlock*>(mData), getBlocksCount(mSamplesCount));
+		}
+	}
+
 	template<bool isT, typename... Args>
 	void emplace(Args&&... arguments)
 	{
@@ -216,14 +584,17 @@ private:
 			allocateData();
 		}
 
+		++mSeenElementsCount;
+		this->onElementsSeen(1);
+
 		if (mFilledElementsCount < mSamplesCount)
 		{
-			insertInitial(std::forward<Args>(arguments)...);
+			insertInitial<isT>(std::forward<Args>(arguments)...);
 
 			if (mFilledElementsCount == mSamplesCount)
 			{
-				mWeightJumpOver = std::exp(std::log(mUniformDist(mRand)) / mSamplesCount);
-				mIndexesToJumpOver = static_cast<size_t>(std::floor(std::log(mUniformDist(mRand))/std::log(static_cast<RandType>(1.0) - mWeightJumpOver)));
+				mWeightJumpOver = std::exp(std::log(generateUniform()) / mSamplesCount);
+				mIndexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), mWeightJumpOver);
 			}
 		}
 		else
@@ -232,49 +603,93 @@ private:
 			{
 				replaceElement<isT>(std::forward<Args>(arguments)...);
 
-				mWeightJumpOver *= std::exp(std::log(mUniformDist(mRand)) / mSamplesCount);
-				mIndexesToJumpOver += static_cast<size_t>(std::floor(std::log(mUniformDist(mRand))/std::log(static_cast<RandType>(1.0) - mWeightJumpOver)));
+				mWeightJumpOver *= std::exp(std::log(generateUniform()) / mSamplesCount);
+				mIndexesToJumpOver += ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), mWeightJumpOver);
 			}
 			else
 			{
 				--mIndexesToJumpOver;
+				this->onElementsSkipped(1);
 			}
 		}
 	}
 
-	template<typename... Args>
+	template<bool isT, typename... Args>
 	void insertInitial(Args&&... arguments)
 	{
-		new (mElements + mFilledElementsCount) T(std::forward<Args>(arguments)...);
+		setElement<isT>(mFilledElementsCount, std::forward<Args>(arguments)...);
 		++mFilledElementsCount;
 	}
 
 	template<bool isT, typename... Args>
 	void replaceElement(Args&&... arguments)
 	{
-		const size_t pos = mSamplesCount > 1 ? (mRand() % mSamplesCount) : 0;
+		const size_t pos = mSamplesCount > 1 ? generateBounded(mSamplesCount) : 0;
+		assignElement<isT>(pos, std::forward<Args>(arguments)...);
+	}
+
+	// constructs the element at pos, or assigns to it if it is kept constructed after resetKeepingElements
+	template<bool isT, typename... Args>
+	void setElement(size_t pos, Args&&... arguments)
+	{
+		if (pos < mConstructedElementsCount)
+		{
+			assignElement<isT>(pos, std::forward<Args>(arguments)...);
+		}
+		else
+		{
+			assert(pos == mConstructedElementsCount);
+			new (mElements + pos) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			++mConstructedElementsCount;
+		}
+	}
+
+	template<bool isT, typename... Args>
+	void assignElement(size_t pos, Args&&... arguments)
+	{
 		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
 		{
 			mElements[pos] = std::forward<Args...>(arguments...);
+			this->onAssignment();
 		}
 		else if constexpr (std::is_move_assignable_v<T>)
 		{
 			mElements[pos] = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
 		}
 		else
 		{
 			mElements[pos].~T();
 			new (mElements + pos) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
 		}
 	}
 
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mRand);
+	}
+
+	size_t generateBounded(size_t bound)
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateBounded(mRand, bound);
+	}
+
 private:
 	const size_t mSamplesCount;
 	size_t mIndexesToJumpOver = 0;
 	RandType mWeightJumpOver {};
 	URNG mRand;
-	std::uniform_real_distribution<RandType> mUniformDist{static_cast<RandType>(0.0), static_cast<RandType>(1.0)};
 	size_t mFilledElementsCount = 0;
+	size_t mSeenElementsCount = 0;
+	// can be bigger than mFilledElementsCount when the elements are kept after resetKeepingElements
+	size_t mConstructedElementsCount = 0;
+	BlockAllocator mAllocator;
 	T* mElements = nullptr;
 	void* mData = nullptr;
+	bool mHasExternalStorage = false;
 };
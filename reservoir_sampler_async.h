@@ -0,0 +1,297 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "reservoir_sampler_weighted.h"
+
+// ReservoirSamplerAsync moves the work of ReservoirSamplerWeighted from the thread that produces the elements to a consumer thread
+// The producer puts the elements into a bounded single-producer single-consumer lock-free ring and the consumer
+// calls processQueued to feed them to the sampler, e.g. from its own thread or from a task of an executor
+// After every call to processQueued the consumer publishes the total weight that the stream should reach before an element
+// can be considered, so the producer rejects the elements inside of the jump gaps with one atomic load and never enqueues them.
+// The published value can only be behind the actual one and is lowered by the possible rounding errors, in these cases
+// the producer enqueues the elements that the sampler will skip itself, so no element that should be considered is dropped
+// The skipped elements are subtracted from the jump as one sum, so the result has the same distribution as with
+// ReservoirSamplerWeighted, but because of the rounding it is not always bit-identical to feeding the elements to it directly
+//
+// Important: only one thread can produce the elements and only one thread can process them at a time
+// Important: the methods that access the result or reset the state should not be called concurrently with sampling
+// Important: the weights are summed up in a double, so the sum of weights that go through one instance should fit into it with enough precision
+template<typename T, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerAsync
+{
+public:
+	using Sampler = ReservoirSamplerWeighted<T, WeightType, URNG, RandType, StatsPolicy>;
+	using ResultSpan = typename Sampler::ResultSpan;
+
+public:
+	// queueCapacity is rounded up to a power of two
+	template<typename URNG_T = URNG>
+	ReservoirSamplerAsync(size_t samplesCount, size_t queueCapacity, URNG_T&& rand = URNG{std::random_device{}()})
+		: mQueueMask(getQueueSize(queueCapacity) - 1)
+		, mQueue(std::allocator<Entry>().allocate(mQueueMask + 1))
+		, mSampler(samplesCount, std::forward<URNG_T>(rand))
+	{
+	}
+
+	~ReservoirSamplerAsync()
+	{
+		clearQueue();
+		std::allocator<Entry>().deallocate(mQueue, mQueueMask + 1);
+	}
+
+	ReservoirSamplerAsync(const ReservoirSamplerAsync&) = delete;
+	ReservoirSamplerAsync(ReservoirSamplerAsync&&) = delete;
+	ReservoirSamplerAsync& operator=(const ReservoirSamplerAsync&) = delete;
+	ReservoirSamplerAsync& operator=(ReservoirSamplerAsync&&) = delete;
+
+	// producer side, returns false if the element should be put into the queue but the queue is full,
+	// the element is not taken in this case and the call can be repeated later
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	bool trySampleElement(WeightType weight, E&& element)
+	{
+		return tryEmplace(weight, std::move(element));
+	}
+
+	// producer side, refer to the comment above the other overload
+	bool trySampleElement(WeightType weight, const T& element)
+	{
+		return tryEmplace(weight, element);
+	}
+
+	// producer side, refer to the comment above trySampleElement
+	template<typename... Args>
+	bool trySampleElementEmplace(WeightType weight, Args&&... arguments)
+	{
+		return tryEmplace(weight, std::forward<Args>(arguments)...);
+	}
+
+	// producer side, waits for the consumer if the queue is full
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(WeightType weight, E&& element)
+	{
+		while (!tryEmplace(weight, std::move(element)))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// producer side, waits for the consumer if the queue is full
+	void sampleElement(WeightType weight, const T& element)
+	{
+		while (!tryEmplace(weight, element))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// producer side, waits for the consumer if the queue is full
+	// the arguments are not moved from until the element is constructed, so they can be forwarded on every attempt
+	template<typename... Args>
+	void sampleElementEmplace(WeightType weight, Args&&... arguments)
+	{
+		while (!tryEmplace(weight, std::forward<Args>(arguments)...))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// producer side, optionally use this function in combination with skipNextElement in case creation of an object is expensive
+	// you can call skipNextElement every time this method returns false as in these cases the objects will be skipped
+	bool willNextElementBeConsidered(WeightType weight) const
+	{
+		return static_cast<RandType>(weight) > static_cast<RandType>(0.0)
+			&& mProducerWeightSum + static_cast<double>(weight) >= mWeightSumToConsider.load(std::memory_order_acquire);
+	}
+
+	// producer side, optionally use this in combination with willNextElementBeConsidered, refer to the comment above willNextElementBeConsidered
+	void skipNextElement(WeightType weight)
+	{
+		assert(!willNextElementBeConsidered(weight));
+		if (static_cast<RandType>(weight) > static_cast<RandType>(0.0))
+		{
+			mProducerWeightSum += static_cast<double>(weight);
+		}
+		++mProducerSkippedCount;
+	}
+
+	// consumer side, feeds up to maxCount queued elements to the sampler and returns the amount of processed elements
+	size_t processQueued(size_t maxCount = std::numeric_limits<size_t>::max())
+	{
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		const size_t count = std::min(mTail.load(std::memory_order_acquire) - head, maxCount);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			Entry& entry = mQueue[(head + i) & mQueueMask];
+			if (entry.skippedCount > 0)
+			{
+				mSampler.jumpAhead(entry.skippedCount, static_cast<RandType>(entry.weightSumBefore - mConsumerWeightSum));
+			}
+			mSampler.sampleElement(entry.weight, std::move(entry.element));
+			mConsumerWeightSum = entry.weightSumBefore + static_cast<double>(entry.weight);
+			entry.~Entry();
+		}
+
+		mHead.store(head + count, std::memory_order_release);
+
+		if (count > 0)
+		{
+			mWeightSumToConsider.store(getWeightSumToConsider(), std::memory_order_release);
+		}
+
+		return count;
+	}
+
+	// the amount of elements that are waiting to be processed
+	size_t getQueuedCount() const
+	{
+		return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+	}
+
+	// contains only the processed elements
+	ResultSpan getResult() const
+	{
+		return mSampler.getResult();
+	}
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result = mSampler.consumeResult();
+		reset();
+		return result;
+	}
+
+	size_t getResultSize() const { return mSampler.getResultSize(); }
+
+	// fully resets the state and cleans all the stored data including the queued elements, allowing to be reused for a new sampling
+	void reset()
+	{
+		clearQueue();
+		mSampler.reset();
+		mProducerWeightSum = 0.0;
+		mProducerSkippedCount = 0;
+		mConsumerWeightSum = 0.0;
+		mWeightSumToConsider.store(0.0, std::memory_order_relaxed);
+	}
+
+	// should not be called concurrently with processQueued
+	const Sampler& getSampler() const { return mSampler; }
+
+private:
+	struct Entry
+	{
+		// the sum of weights of all the elements before this one and the amount of elements skipped right before it
+		double weightSumBefore;
+		size_t skippedCount;
+		WeightType weight;
+		T element;
+	};
+
+private:
+	static size_t getQueueSize(size_t queueCapacity)
+	{
+		assert(queueCapacity > 0);
+		size_t size = 1;
+		while (size < queueCapacity)
+		{
+			size <<= 1;
+		}
+		return size;
+	}
+
+	template<typename... Args>
+	bool tryEmplace(WeightType weight, Args&&... arguments)
+	{
+		if (!willNextElementBeConsidered(weight))
+		{
+			skipNextElement(weight);
+			return true;
+		}
+
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mProducerCachedHead > mQueueMask)
+		{
+			mProducerCachedHead = mHead.load(std::memory_order_acquire);
+			if (tail - mProducerCachedHead > mQueueMask)
+			{
+				return false;
+			}
+		}
+
+		new (mQueue + (tail & mQueueMask)) Entry{mProducerWeightSum, mProducerSkippedCount, weight, T(std::forward<Args>(arguments)...)};
+		mProducerWeightSum += static_cast<double>(weight);
+		mProducerSkippedCount = 0;
+
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// the producer compares the sums in double while the sampler subtracts the weights in RandType,
+	// the margin covers a few rounding errors of both, so the elements near the end of the jump are always enqueued
+	double getWeightSumToConsider() const
+	{
+		const double weightJumpOver = static_cast<double>(mSampler.getWeightToJumpOver());
+		const double margin = weightJumpOver * 4.0 * static_cast<double>(std::numeric_limits<RandType>::epsilon())
+			+ (mConsumerWeightSum + weightJumpOver) * 4.0 * std::numeric_limits<double>::epsilon();
+		return mConsumerWeightSum + weightJumpOver - margin;
+	}
+
+	void clearQueue()
+	{
+		const size_t tail = mTail.load(std::memory_order_acquire);
+		for (size_t i = mHead.load(std::memory_order_relaxed); i != tail; ++i)
+		{
+			mQueue[i & mQueueMask].~Entry();
+		}
+		mHead.store(0, std::memory_order_relaxed);
+		mTail.store(0, std::memory_order_relaxed);
+		mProducerCachedHead = 0;
+	}
+
+private:
+	// the producer and the consumer data are kept in different cache lines
+	alignas(64) std::atomic<size_t> mTail{0};
+	double mProducerWeightSum = 0.0;
+	size_t mProducerSkippedCount = 0;
+	size_t mProducerCachedHead = 0;
+
+	alignas(64) std::atomic<size_t> mHead{0};
+	double mConsumerWeightSum = 0.0;
+
+	alignas(64) std::atomic<double> mWeightSumToConsider{0.0};
+
+	alignas(64) const size_t mQueueMask;
+	Entry* const mQueue;
+	Sampler mSampler;
+};
@@ -0,0 +1,173 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler.h"
+
+// ReservoirSamplerConcurrent is a thread-safe front-end for ReservoirSampler that can be fed from multiple threads
+// Every element gets its index in the stream from an atomic counter, the elements that fall into a jump gap
+// are rejected without taking the lock, only the considered elements are processed under the mutex
+//
+// Important: the order of the stream is defined by the order in which the threads got their indexes
+// Important: the considered elements are processed strictly in the order of their indexes, a thread with a considered
+// element waits for the threads with the earlier considered elements, during the fill phase every element is considered,
+// so the producers are fully serialized until the reservoir is filled
+// Important: the methods that access the result or reset the state should not be called concurrently with sampling
+template<typename T, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerConcurrent
+{
+public:
+	using ResultSpan = typename ReservoirSampler<T, URNG, RandType, StatsPolicy>::ResultSpan;
+
+public:
+	template<typename URNG_T = URNG>
+	explicit ReservoirSamplerConcurrent(size_t samplesCount, URNG_T&& rand = URNG{std::random_device{}()})
+		: mSampler(samplesCount, std::forward<URNG_T>(rand))
+	{
+	}
+
+	ReservoirSamplerConcurrent(const ReservoirSamplerConcurrent&) = delete;
+	ReservoirSamplerConcurrent(ReservoirSamplerConcurrent&&) = delete;
+	ReservoirSamplerConcurrent& operator=(const ReservoirSamplerConcurrent&) = delete;
+	ReservoirSamplerConcurrent& operator=(ReservoirSamplerConcurrent&&) = delete;
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(E&& element)
+	{
+		sampleIfConsidered([&element](auto& sampler) { sampler.sampleElement(std::move(element)); });
+	}
+
+	void sampleElement(const T& element)
+	{
+		sampleIfConsidered([&element](auto& sampler) { sampler.sampleElement(element); });
+	}
+
+	template<typename... Args>
+	void sampleElementEmplace(Args&&... arguments)
+	{
+		sampleIfConsidered([&arguments...](auto& sampler) { sampler.sampleElementEmplace(std::forward<Args>(arguments)...); });
+	}
+
+	ResultSpan getResult() const
+	{
+		return mSampler.getResult();
+	}
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result = mSampler.consumeResult();
+		reset();
+		return result;
+	}
+
+	size_t getResultSize() const { return mSampler.getResultSize(); }
+
+	// outRawData should point to a C-array with enough memory to fit getResultSize() elements
+	void consumeResultTo(T* outRawData)
+	{
+		mSampler.consumeResultTo(outRawData);
+		reset();
+	}
+
+	// fully resets the state and cleans all the stored data, allowing to be reused for a new sampling
+	void reset()
+	{
+		mSampler.reset();
+		mStreamIndex.store(0, std::memory_order_relaxed);
+		mNextConsideredIndex.store(0, std::memory_order_relaxed);
+	}
+
+	// amount of elements that went through the sampler since the last reset, including the skipped ones
+	size_t getSeenElementsCount() const
+	{
+		return mStreamIndex.load(std::memory_order_relaxed);
+	}
+
+	// should not be called concurrently with sampling
+	const StatsPolicy& getStats() const { return mSampler.getStats(); }
+
+private:
+	template<typename SampleFunc>
+	void sampleIfConsidered(SampleFunc&& sampleFunc)
+	{
+		const size_t index = mStreamIndex.fetch_add(1, std::memory_order_relaxed);
+
+		// the next considered index only grows, so anything before it is inside of a jump gap
+		if (index < mNextConsideredIndex.load(std::memory_order_acquire))
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		// the thread that owns the currently considered index can still be on its way to the lock,
+		// the elements after it can't be processed before the next jump is known
+		mNextConsideredIndexChanged.wait(lock, [this, index]{ return mNextConsideredIndex.load(std::memory_order_relaxed) >= index; });
+
+		if (mNextConsideredIndex.load(std::memory_order_relaxed) != index)
+		{
+			return;
+		}
+
+		// the index should advance even if constructing the element throws, otherwise the later threads would wait forever
+		struct ConsideredIndexGuard
+		{
+			~ConsideredIndexGuard()
+			{
+				// the jump can be as long as SIZE_MAX, then the rest of the stream is skipped
+				const size_t skippedCount = sampler.mSampler.getNextSkippedElementsCount();
+				constexpr size_t maxIndex = std::numeric_limits<size_t>::max();
+				const size_t nextIndex = (skippedCount < maxIndex - index) ? index + 1 + skippedCount : maxIndex;
+				sampler.mNextConsideredIndex.store(nextIndex, std::memory_order_release);
+				lock.unlock();
+				sampler.mNextConsideredIndexChanged.notify_all();
+			}
+
+			ReservoirSamplerConcurrent& sampler;
+			std::unique_lock<std::mutex>& lock;
+			const size_t index;
+		} guard{*this, lock, index};
+
+		// the gap is tracked by the index instead of the sampler itself, so we jump over it only when it has passed
+		mSampler.jumpAhead(mSampler.getNextSkippedElementsCount());
+
+		sampleFunc(mSampler);
+	}
+
+private:
+	// the counter is modified by every call, keep it away from the rest of the data
+	alignas(64) std::atomic<size_t> mStreamIndex{0};
+	alignas(64) std::atomic<size_t> mNextConsideredIndex{0};
+	std::mutex mMutex;
+	std::condition_variable mNextConsideredIndexChanged;
+	ReservoirSampler<T, URNG, RandType, StatsPolicy> mSampler;
+};
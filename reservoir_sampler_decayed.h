@@ -0,0 +1,128 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reservoir_sampler_weighted.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerDecayed samples with exponential time decay, an element of age a has weight exp(-decayRate * a) relative to a new one
+// It uses forward decay: an element at time t gets weight exp(decayRate * (t - landmark)), which gives the same sampling as decaying
+// all the old weights, but doesn't require to touch the stored elements on every step
+// When the weights grow too big, the landmark is moved forward and the sampler weights are rescaled, which is O(k) but rare
+// The times of the elements should be mostly non-decreasing, older elements are accepted with lower weights
+// StatsPolicy is used by the underlying weighted sampler, see reservoir_sampler_stats.h
+template<typename T, typename TimeType = double, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerDecayed
+{
+public:
+	using Sampler = ReservoirSamplerWeighted<T, RandType, URNG, RandType, StatsPolicy>;
+	using ResultSpan = typename Sampler::ResultSpan;
+
+public:
+	template<typename URNG_T = URNG>
+	ReservoirSamplerDecayed(size_t samplesCount, RandType decayRate, URNG_T&& rand = URNG{std::random_device{}()})
+		: mDecayRate(decayRate)
+		, mSampler(samplesCount, std::forward<URNG_T>(rand))
+	{
+		static_assert(std::is_arithmetic_v<TimeType>, "TimeType should be arithmetic type");
+		assert(decayRate > static_cast<RandType>(0.0));
+	}
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(TimeType time, E&& element)
+	{
+		mSampler.sampleElement(getWeight(time), std::move(element));
+	}
+
+	void sampleElement(TimeType time, const T& element)
+	{
+		mSampler.sampleElement(getWeight(time), element);
+	}
+
+	template<typename... Args>
+	void sampleElementEmplace(TimeType time, Args&&... arguments)
+	{
+		mSampler.sampleElementEmplace(getWeight(time), std::forward<Args>(arguments)...);
+	}
+
+	ResultSpan getResult() const
+	{
+		return mSampler.getResult();
+	}
+
+	std::vector<T> consumeResult()
+	{
+		mLandmark = {};
+		mHasLandmark = false;
+		return mSampler.consumeResult();
+	}
+
+	size_t getResultSize() const { return mSampler.getResultSize(); }
+
+	// fully resets the state and cleans all the stored data, allowing to be reused for a new sampling
+	void reset()
+	{
+		mSampler.reset();
+		mLandmark = {};
+		mHasLandmark = false;
+	}
+
+	const StatsPolicy& getStats() const { return mSampler.getStats(); }
+	StatsPolicy& getStats() { return mSampler.getStats(); }
+
+private:
+	RandType getWeight(TimeType time)
+	{
+		if (!mHasLandmark)
+		{
+			mLandmark = time;
+			mHasLandmark = true;
+		}
+
+		RandType exponent = mDecayRate * static_cast<RandType>(time - mLandmark);
+		if (exponent > MaxWeightExponent)
+		{
+			// move the landmark to the current time, which divides all the weights by exp(exponent)
+			mSampler.scaleWeights(std::exp(-exponent));
+			mLandmark = time;
+			exponent = static_cast<RandType>(0.0);
+		}
+		return std::exp(exponent);
+	}
+
+private:
+	// weights are kept below exp(MaxWeightExponent), which fits float with a big margin
+	static constexpr RandType MaxWeightExponent = static_cast<RandType>(20.0);
+
+	const RandType mDecayRate;
+	Sampler mSampler;
+	TimeType mLandmark {};
+	bool mHasLandmark = false;
+};
@@ -0,0 +1,121 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reservoir_sampler.h"
+
+// ReservoirSamplerDeferred samples cheap handles (e.g. indexes, ids or pointers) instead of the elements
+// and builds the elements only for the sampled handles when the result is consumed
+// With Algorithm L an element in a slot is replaced about log(n/k) times, so sampling handles of heavy elements
+// turns these replacements into copies of handles and leaves only k constructions of the elements
+// HandleSampler can be any sampler with a handle as the element type, e.g. ReservoirSamplerWeighted<Handle>,
+// the sampling functions are forwarded to it as they are
+//
+// Important: everything that the handles refer to should stay alive until the result is consumed
+template<typename T, typename Handle, typename HandleSampler = ReservoirSampler<Handle>>
+class ReservoirSamplerDeferred
+{
+public:
+	template<typename... SamplerArgs>
+	explicit ReservoirSamplerDeferred(SamplerArgs&&... samplerArguments)
+		: mSampler(std::forward<SamplerArgs>(samplerArguments)...)
+	{
+	}
+
+	// the arguments are the same as for sampleElement of HandleSampler, e.g. (handle) or (weight, handle)
+	template<typename... Args>
+	void sampleElement(Args&&... arguments)
+	{
+		mSampler.sampleElement(std::forward<Args>(arguments)...);
+	}
+
+	template<typename... Args>
+	bool willNextElementBeConsidered(Args&&... arguments) const
+	{
+		return mSampler.willNextElementBeConsidered(std::forward<Args>(arguments)...);
+	}
+
+	template<typename... Args>
+	void skipNextElement(Args&&... arguments)
+	{
+		mSampler.skipNextElement(std::forward<Args>(arguments)...);
+	}
+
+	// returns the sampled handles without building the elements
+	auto getHandles() const
+	{
+		return mSampler.getResult();
+	}
+
+	size_t getResultSize() const { return mSampler.getResultSize(); }
+
+	// builds the elements from the sampled handles and resets the sampler
+	// factory(Handle&&) is called once per sampled handle and should return the element
+	template<typename Factory>
+	std::vector<T> consumeResult(Factory&& factory)
+	{
+		std::vector<T> result;
+		result.reserve(mSampler.getResultSize());
+		for (Handle& handle : mSampler.getResult())
+		{
+			result.push_back(std::invoke(factory, std::move(handle)));
+		}
+
+		mSampler.reset();
+
+		return result;
+	}
+
+	// outRawData should point to a C-array with enough memory to fit getResultSize() elements
+	// the elements are constructed in place, so the memory should not contain constructed objects
+	template<typename Factory>
+	void consumeResultTo(T* outRawData, Factory&& factory)
+	{
+		for (Handle& handle : mSampler.getResult())
+		{
+			new (outRawData++) T(std::invoke(factory, std::move(handle)));
+		}
+
+		mSampler.reset();
+	}
+
+	// fully resets the state and cleans all the stored handles, allowing to be reused for a new sampling
+	void reset()
+	{
+		mSampler.reset();
+	}
+
+	const HandleSampler& getHandleSampler() const { return mSampler; }
+	HandleSampler& getHandleSampler() { return mSampler; }
+
+	// the stats of the handle sampler
+	decltype(auto) getStats() const { return mSampler.getStats(); }
+
+private:
+	HandleSampler mSampler;
+};
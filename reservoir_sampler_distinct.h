@@ -0,0 +1,408 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler_heap.h"
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerDistinct samples distinct elements regardless of how many times each of them appears in the stream
+// It keeps the k elements with the smallest hashes (bottom-k sketch), so the result is a uniform sample of the distinct elements
+// An element with a hash above the current threshold is rejected with one hash and one compare,
+// the elements below it are looked up in a hash index of the stored elements, so a frequent duplicate costs one probe
+// The hashes are mixed with SplitMix64, so weak hashes (e.g. std::hash for integers) can be used
+// The stored hashes also give an estimate of the amount of distinct elements, and the samplers can be merged
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+// HeapPolicy defines the layout of the heap of hashes, see reservoir_sampler_heap.h
+template<typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>, typename StatsPolicy = ReservoirSamplerNoStats, typename HeapPolicy = ReservoirSamplerBinaryHeap>
+class ReservoirSamplerDistinct : private StatsPolicy
+{
+public:
+	// C++17 doesn't support std::span, so we can do this instead
+	struct ResultSpan
+	{
+		ResultSpan(T* data, size_t size)
+			: data(data)
+			, size(size)
+		{}
+
+		T* data;
+		size_t size;
+
+		T* begin() { return data; }
+		const T* begin() const { return data; }
+		T* end() { return data + size; }
+		const T* end() const { return data + size; }
+	};
+
+private:
+	// the heap keeps the lowest priority on top, so the priority is the inverted hash to have the biggest hash on top
+	using HeapItem = typename HeapPolicy::template Item<uint64_t>;
+	using IndexType = decltype(HeapItem::index);
+
+	static constexpr IndexType EmptySlot = std::numeric_limits<IndexType>::max();
+
+public:
+	explicit ReservoirSamplerDistinct(size_t samplesCount, const Hash& hash = Hash(), const KeyEqual& keyEqual = KeyEqual())
+		: mSamplesCount(samplesCount)
+		, mHash(hash)
+		, mKeyEqual(keyEqual)
+	{
+		assert(samplesCount > 0);
+		// the biggest index is reserved for the empty slots of the hash index
+		assert(samplesCount < HeapPolicy::MaxItemsCount);
+	}
+
+	~ReservoirSamplerDistinct()
+	{
+		reset();
+		if (mElements != nullptr)
+		{
+			std::allocator<T>().deallocate(mElements, mSamplesCount);
+		}
+	}
+
+	ReservoirSamplerDistinct(const ReservoirSamplerDistinct& other)
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
+		, mHash(other.mHash)
+		, mKeyEqual(other.mKeyEqual)
+		, mHeap(other.mHeap)
+		, mElementHashes(other.mElementHashes)
+		, mHashIndex(other.mHashIndex)
+		, mFilledElementsCount(other.mFilledElementsCount)
+	{
+		if (other.mElements != nullptr)
+		{
+			allocateData();
+			for (size_t i = 0; i < mFilledElementsCount; ++i)
+			{
+				new (mElements + i) T(other.mElements[i]);
+				this->onConstruction();
+			}
+		}
+	}
+
+	ReservoirSamplerDistinct(ReservoirSamplerDistinct&& other) noexcept
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
+		, mHash(std::move(other.mHash))
+		, mKeyEqual(std::move(other.mKeyEqual))
+		, mHeap(std::move(other.mHeap))
+		, mElementHashes(std::move(other.mElementHashes))
+		, mHashIndex(std::move(other.mHashIndex))
+		, mFilledElementsCount(other.mFilledElementsCount)
+		, mElements(other.mElements)
+	{
+		other.mHeap.clear();
+		other.mElementHashes.clear();
+		other.mHashIndex.clear();
+		other.mFilledElementsCount = 0;
+		other.mElements = nullptr;
+	}
+
+	ReservoirSamplerDistinct& operator=(const ReservoirSamplerDistinct&) = delete;
+	ReservoirSamplerDistinct& operator=(ReservoirSamplerDistinct&&) noexcept = delete;
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(E&& element)
+	{
+		insert(getHash(element), std::move(element));
+	}
+
+	void sampleElement(const T& element)
+	{
+		insert(getHash(element), element);
+	}
+
+	// optionally use this function to not construct elements that don't need to be stored
+	// the hash should be calculated the same way as the one returned by getHash
+	bool willElementBeConsidered(uint64_t hash) const
+	{
+		return mFilledElementsCount < mSamplesCount || mHeap[0].priority < ~hash;
+	}
+
+	// mixed hash of an element, as used by the sampler
+	uint64_t getHash(const T& element) const
+	{
+		return ReservoirSamplerUtils::SplitMix64::mix(static_cast<uint64_t>(mHash(element)));
+	}
+
+	ResultSpan getResult() const
+	{
+		return ResultSpan(mElements, mFilledElementsCount);
+	}
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result;
+		result.reserve(mFilledElementsCount);
+		std::move(mElements, mElements + mFilledElementsCount, std::back_inserter(result));
+
+		reset();
+
+		return result;
+	}
+
+	size_t getResultSize() const { return mFilledElementsCount; }
+
+	// estimated amount of distinct elements that went through the sampler (exact while it is not full)
+	double getDistinctCountEstimate() const
+	{
+		if (mFilledElementsCount < mSamplesCount)
+		{
+			return static_cast<double>(mFilledElementsCount);
+		}
+
+		// the k-th smallest of n uniform hashes is expected to be at k/(n+1), (k-1)/kthHash is the unbiased estimate
+		const double kthHash = (static_cast<double>(~mHeap[0].priority) + 1.0) / 18446744073709551616.0;
+		return static_cast<double>(mSamplesCount - 1) / kthHash;
+	}
+
+	// fully resets the state and cleans all the stored data, allowing to be reused for a new sampling
+	void reset()
+	{
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			mElements[i].~T();
+		}
+		mHeap.clear();
+		std::fill(mHashIndex.begin(), mHashIndex.end(), EmptySlot);
+		mFilledElementsCount = 0;
+	}
+
+	// merges the distinct elements of another sampler into this one, both samplers should have the same samples count
+	// the result and the estimate are the same as if all the elements were sampled by this sampler
+	void merge(const ReservoirSamplerDistinct& other)
+	{
+		assert(this != &other);
+		assert(mSamplesCount == other.mSamplesCount);
+
+		for (const HeapItem& item : other.mHeap)
+		{
+			insert(~item.priority, other.mElements[item.index]);
+		}
+	}
+
+	// writes the stored elements with their hashes to the end of buffer
+	// Codec defines how the elements are written, the default one copies the bytes of trivially copyable types
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Distinct, mSamplesCount);
+		writer.write(mFilledElementsCount);
+		writer.writeBytes(mElementHashes.data(), sizeof(uint64_t)*mFilledElementsCount);
+		ReservoirSamplerUtils::writeElements(writer, mElements, mFilledElementsCount, codec);
+	}
+
+	// restores the state written by serialize, the sampler should have the same samples count
+	// returns false if the data can't be read, in this case the sampler is left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		size_t filledElementsCount = 0;
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Distinct, mSamplesCount)
+			|| !reader.read(filledElementsCount)
+			|| filledElementsCount > mSamplesCount)
+		{
+			return false;
+		}
+
+		if (filledElementsCount > 0 && mElements == nullptr)
+		{
+			allocateData();
+		}
+
+		if (!reader.readBytes(mElementHashes.data(), sizeof(uint64_t)*filledElementsCount))
+		{
+			return false;
+		}
+
+		mFilledElementsCount = ReservoirSamplerUtils::readElements(reader, mElements, filledElementsCount, codec);
+		if (mFilledElementsCount != filledElementsCount)
+		{
+			reset();
+			return false;
+		}
+
+		// the heap and the hash index are rebuilt from the hashes, the heap keeps the same element on top
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			const size_t slot = findSlot(mElementHashes[i], mElements[i]);
+			if (mHashIndex[slot] != EmptySlot)
+			{
+				reset();
+				return false;
+			}
+			mHashIndex[slot] = static_cast<IndexType>(i);
+			mHeap.push_back({~mElementHashes[i], static_cast<IndexType>(i)});
+			HeapPolicy::siftUp(mHeap.data(), i);
+		}
+		return true;
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+	// optionally use if you don't want to delay the memory allocation to the moment of adding the first element
+	void allocateData()
+	{
+		assert(mElements == nullptr);
+		mElements = std::allocator<T>().allocate(mSamplesCount);
+		mHeap.reserve(mSamplesCount);
+		mElementHashes.resize(mSamplesCount);
+		if (mHashIndex.empty())
+		{
+			// keep the index at most half full to have short probe sequences
+			size_t indexSize = 2;
+			while (indexSize < mSamplesCount * 2)
+			{
+				indexSize *= 2;
+			}
+			mHashIndex.assign(indexSize, EmptySlot);
+		}
+		this->onAllocation();
+	}
+
+private:
+	template<typename E>
+	void insert(uint64_t hash, E&& element)
+	{
+		this->onElementsSeen(1);
+		if (!willElementBeConsidered(hash))
+		{
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		const uint64_t priority = ~hash;
+		if (mElements == nullptr)
+		{
+			allocateData();
+		}
+
+		const size_t slot = findSlot(hash, element);
+		if (mHashIndex[slot] != EmptySlot)
+		{
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		if (mFilledElementsCount < mSamplesCount)
+		{
+			mElementHashes[mFilledElementsCount] = hash;
+			mHashIndex[slot] = static_cast<IndexType>(mFilledElementsCount);
+			mHeap.push_back({priority, static_cast<IndexType>(mFilledElementsCount)});
+			HeapPolicy::siftUp(mHeap.data(), mFilledElementsCount);
+			this->onHeapOperation();
+			new (mElements + mFilledElementsCount) T(std::forward<E>(element));
+			this->onConstruction();
+			++mFilledElementsCount;
+		}
+		else
+		{
+			const size_t oldElementIdx = mHeap[0].index;
+			eraseSlot(findSlot(mElementHashes[oldElementIdx], mElements[oldElementIdx]));
+			mElementHashes[oldElementIdx] = hash;
+			// the erase could have moved the other entries, so the free slot for the new element is searched again
+			mHashIndex[findSlot(hash, element)] = static_cast<IndexType>(oldElementIdx);
+			mHeap[0].priority = priority;
+			HeapPolicy::siftDown(mHeap.data(), mSamplesCount);
+			this->onHeapOperation();
+
+			if constexpr (std::is_assignable_v<T&, E&&>)
+			{
+				mElements[oldElementIdx] = std::forward<E>(element);
+				this->onAssignment();
+			}
+			else
+			{
+				mElements[oldElementIdx].~T();
+				new (mElements + oldElementIdx) T(std::forward<E>(element));
+				this->onConstruction();
+			}
+		}
+	}
+
+	// returns the slot of the element in the hash index, or the empty slot where it should be inserted
+	size_t findSlot(uint64_t hash, const T& element) const
+	{
+		const size_t mask = mHashIndex.size() - 1;
+		for (size_t slot = static_cast<size_t>(hash) & mask;; slot = (slot + 1) & mask)
+		{
+			const IndexType elementIdx = mHashIndex[slot];
+			if (elementIdx == EmptySlot || (mElementHashes[elementIdx] == hash && mKeyEqual(mElements[elementIdx], element)))
+			{
+				return slot;
+			}
+		}
+	}
+
+	// backward shift deletion, keeps the probe sequences of the other elements unbroken
+	void eraseSlot(size_t slot)
+	{
+		const size_t mask = mHashIndex.size() - 1;
+		size_t next = (slot + 1) & mask;
+		while (mHashIndex[next] != EmptySlot)
+		{
+			const size_t idealSlot = static_cast<size_t>(mElementHashes[mHashIndex[next]]) & mask;
+			// move the element back if the freed slot is between its ideal slot and its current slot
+			if (((next - idealSlot) & mask) >= ((next - slot) & mask))
+			{
+				mHashIndex[slot] = mHashIndex[next];
+				slot = next;
+			}
+			next = (next + 1) & mask;
+		}
+		mHashIndex[slot] = EmptySlot;
+	}
+
+private:
+	const size_t mSamplesCount;
+	Hash mHash;
+	KeyEqual mKeyEqual;
+	std::vector<HeapItem> mHeap;
+	// the hashes of the stored elements by their indexes
+	std::vector<uint64_t> mElementHashes;
+	// open addressing hash index from the hashes to the indexes of the stored elements
+	std::vector<IndexType> mHashIndex;
+	size_t mFilledElementsCount = 0;
+	T* mElements = nullptr;
+};
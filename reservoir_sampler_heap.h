@@ -0,0 +1,127 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+// heap policies define how the priority heaps of the weighted samplers are stored and updated
+// the heap keeps the item with the lowest priority on top
+// Arity is the amount of children of every node, a bigger arity makes the heap shallower at the cost of more comparisons per level
+// IndexType is used to store the indexes of the elements, e.g. uint32_t makes the heap items smaller if samples count fits
+// with Arity above 2, when a group of children fits into a cache line, the groups are aligned so sifting down touches one cache line per level
+// the binary heap keeps the plain layout, its pairs of children are too small for the alignment to pay for the padding
+template<size_t Arity = 2, typename IndexType = size_t>
+struct ReservoirSamplerHeap
+{
+	static_assert(Arity >= 2, "Arity should be at least 2");
+	static_assert(std::is_unsigned_v<IndexType>, "IndexType should be unsigned integer type");
+
+	template<typename PriorityType>
+	struct Item
+	{
+		PriorityType priority;
+		IndexType index;
+	};
+
+	static constexpr size_t MaxItemsCount = std::numeric_limits<IndexType>::max();
+
+	// alignment of the storage provided for the heap
+	template<typename Item>
+	static constexpr size_t getAlignment()
+	{
+		return isGroupAligned<Item>() ? Arity*sizeof(Item) : std::alignment_of_v<Item>;
+	}
+
+	// amount of unused items before the top of the heap, required to align the groups of children
+	template<typename Item>
+	static constexpr size_t getPaddingItemsCount()
+	{
+		return isGroupAligned<Item>() ? Arity - 1 : 0;
+	}
+
+	// restores the heap after an item have been added at the given position
+	template<typename Item>
+	static void siftUp(Item* heap, size_t position)
+	{
+		const Item item = heap[position];
+		while (position > 0)
+		{
+			const size_t parent = (position - 1) / Arity;
+			if (!(item.priority < heap[parent].priority))
+			{
+				break;
+			}
+			heap[position] = heap[parent];
+			position = parent;
+		}
+		heap[position] = item;
+	}
+
+	// restores the heap after the priority of the top item have been increased
+	// this replaces the top item with one sift-down instead of a pop and a push
+	template<typename Item>
+	static void siftDown(Item* heap, size_t size)
+	{
+		const Item item = heap[0];
+		size_t position = 0;
+		while (true)
+		{
+			const size_t firstChild = position * Arity + 1;
+			if (firstChild >= size)
+			{
+				break;
+			}
+
+			const size_t childrenEnd = (size - firstChild > Arity) ? firstChild + Arity : size;
+			size_t lowestChild = firstChild;
+			for (size_t child = firstChild + 1; child < childrenEnd; ++child)
+			{
+				if (heap[child].priority < heap[lowestChild].priority)
+				{
+					lowestChild = child;
+				}
+			}
+
+			if (!(heap[lowestChild].priority < item.priority))
+			{
+				break;
+			}
+			heap[position] = heap[lowestChild];
+			position = lowestChild;
+		}
+		heap[position] = item;
+	}
+
+private:
+	template<typename Item>
+	static constexpr bool isGroupAligned()
+	{
+		constexpr size_t groupSize = Arity*sizeof(Item);
+		return Arity > 2 && groupSize <= 64 && (groupSize & (groupSize - 1)) == 0;
+	}
+};
+
+// binary heap with full size indexes, the default for the weighted samplers
+using ReservoirSamplerBinaryHeap = ReservoirSamplerHeap<2, size_t>;
@@ -0,0 +1,355 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler.h"
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerHeavyHitters keeps a uniform sample of the stream together with the most frequent elements of it
+// The frequent elements are tracked with the Space-Saving algorithm in a table of heavyHittersCount counters
+// https://www.cs.ucsb.edu/sites/default/files/documents/2005-23.pdf
+// any element that appears more than elementsCount/heavyHittersCount times is guaranteed to be in the table
+// Every element is hashed once, the hash is used both to find the counter and to compare it before the keys
+// The hashes are mixed with SplitMix64, so weak hashes (e.g. std::hash for integers) can be used
+// The samplers can be merged, the merged counts keep the same guarantees
+// StatsPolicy is used by the sampler of the uniform sample, see reservoir_sampler_stats.h
+template<typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerHeavyHitters
+{
+public:
+	struct HeavyHitter
+	{
+		T element;
+		// the upper bound of how many times the element appeared in the stream
+		uint64_t count;
+		// how much the count can overestimate, count - error is the lower bound
+		uint64_t error;
+	};
+
+	using Sampler = ReservoirSampler<T, URNG, RandType, StatsPolicy>;
+
+public:
+	template<typename URNG_T = URNG, typename = std::enable_if_t<std::is_constructible_v<URNG, URNG_T>>>
+	ReservoirSamplerHeavyHitters(size_t samplesCount, size_t heavyHittersCount, URNG_T&& rand = URNG{std::random_device{}()}, const Hash& hash = Hash(), const KeyEqual& keyEqual = KeyEqual())
+		: mSampler(samplesCount, std::forward<URNG_T>(rand))
+		, mHeavyHittersCount(heavyHittersCount)
+		, mHash(hash)
+		, mKeyEqual(keyEqual)
+	{
+		static_assert(std::is_copy_constructible_v<T>, "The tracked elements are copied into the table");
+		assert(heavyHittersCount > 0);
+		assert(heavyHittersCount < std::numeric_limits<uint32_t>::max() / 2);
+
+		// keep the table at most half full to have short probe sequences
+		size_t tableSize = 1;
+		while (tableSize < heavyHittersCount * 2)
+		{
+			tableSize *= 2;
+		}
+		mTable.resize(tableSize, EmptySlot);
+		mCounters.reserve(heavyHittersCount);
+		mCountersHeap.reserve(heavyHittersCount);
+	}
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(E&& element)
+	{
+		countElement(element, getHash(element), 1, 0);
+		mSampler.sampleElement(std::move(element));
+	}
+
+	void sampleElement(const T& element)
+	{
+		countElement(element, getHash(element), 1, 0);
+		mSampler.sampleElement(element);
+	}
+
+	// uniform sample of all the elements that went through the sampler
+	typename Sampler::ResultSpan getResult() const
+	{
+		return mSampler.getResult();
+	}
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result = mSampler.consumeResult();
+		reset();
+		return result;
+	}
+
+	const Sampler& getSampler() const { return mSampler; }
+
+	const StatsPolicy& getStats() const { return mSampler.getStats(); }
+
+	// the tracked elements ordered from the most frequent to the least frequent
+	std::vector<HeavyHitter> getHeavyHitters() const
+	{
+		std::vector<HeavyHitter> result;
+		result.reserve(mCounters.size());
+		for (const Counter& counter : mCounters)
+		{
+			result.push_back({counter.element, counter.count, counter.error});
+		}
+		std::sort(result.begin(), result.end(), [](const HeavyHitter& a, const HeavyHitter& b) { return a.count > b.count; });
+		return result;
+	}
+
+	// the upper bound of how many times the element appeared in the stream
+	uint64_t getCountEstimate(const T& element) const
+	{
+		const size_t counterIdx = findCounter(element, getHash(element));
+		if (counterIdx != NotFound)
+		{
+			return mCounters[counterIdx].count;
+		}
+		return getMinCount();
+	}
+
+	// amount of elements that went through the sampler since the last reset
+	size_t getSeenElementsCount() const { return mSampler.getSeenElementsCount(); }
+
+	// fully resets the state and cleans all the stored data, allowing to be reused for a new sampling
+	void reset()
+	{
+		mSampler.reset();
+		mCounters.clear();
+		mCountersHeap.clear();
+		std::fill(mTable.begin(), mTable.end(), EmptySlot);
+	}
+
+	// merges the sample and the counters of another sampler into this one, both samplers should have the same samples count
+	// an element that is not tracked by one of the samplers can have appeared in it up to its smallest count times,
+	// so that count is added to both the count and the error of the element, then the most frequent elements are kept
+	void merge(const ReservoirSamplerHeavyHitters& other)
+	{
+		assert(this != &other);
+
+		mSampler.merge(other.mSampler);
+
+		const uint64_t thisMinCount = getMinCount();
+		const uint64_t otherMinCount = other.getMinCount();
+
+		std::vector<Counter> merged;
+		merged.reserve(mCounters.size() + other.mCounters.size());
+		for (const Counter& counter : mCounters)
+		{
+			const size_t otherIdx = other.findCounter(counter.element, counter.hash);
+			if (otherIdx != NotFound)
+			{
+				const Counter& otherCounter = other.mCounters[otherIdx];
+				merged.push_back({counter.element, counter.hash, counter.count + otherCounter.count, counter.error + otherCounter.error, 0});
+			}
+			else
+			{
+				merged.push_back({counter.element, counter.hash, counter.count + otherMinCount, counter.error + otherMinCount, 0});
+			}
+		}
+		for (const Counter& otherCounter : other.mCounters)
+		{
+			if (findCounter(otherCounter.element, otherCounter.hash) == NotFound)
+			{
+				merged.push_back({otherCounter.element, otherCounter.hash, otherCounter.count + thisMinCount, otherCounter.error + thisMinCount, 0});
+			}
+		}
+
+		if (merged.size() > mHeavyHittersCount)
+		{
+			std::nth_element(merged.begin(), merged.begin() + (mHeavyHittersCount - 1), merged.end(), [](const Counter& a, const Counter& b) { return a.count > b.count; });
+			merged.erase(merged.begin() + mHeavyHittersCount, merged.end());
+		}
+
+		mCounters.clear();
+		mCountersHeap.clear();
+		std::fill(mTable.begin(), mTable.end(), EmptySlot);
+		for (Counter& counter : merged)
+		{
+			countElement(std::move(counter.element), counter.hash, counter.count, counter.error);
+		}
+	}
+
+private:
+	struct Counter
+	{
+		T element;
+		uint64_t hash;
+		uint64_t count;
+		uint64_t error;
+		uint32_t heapPos;
+	};
+
+	static constexpr uint32_t EmptySlot = std::numeric_limits<uint32_t>::max();
+	static constexpr size_t NotFound = std::numeric_limits<size_t>::max();
+
+private:
+	uint64_t getHash(const T& element) const
+	{
+		return ReservoirSamplerUtils::SplitMix64::mix(static_cast<uint64_t>(mHash(element)));
+	}
+
+	uint64_t getMinCount() const
+	{
+		return mCountersHeap.size() < mHeavyHittersCount ? 0 : mCounters[mCountersHeap[0]].count;
+	}
+
+	size_t findSlot(const T& element, uint64_t hash) const
+	{
+		const size_t mask = mTable.size() - 1;
+		for (size_t slot = static_cast<size_t>(hash) & mask;; slot = (slot + 1) & mask)
+		{
+			const uint32_t counterIdx = mTable[slot];
+			if (counterIdx == EmptySlot || (mCounters[counterIdx].hash == hash && mKeyEqual(mCounters[counterIdx].element, element)))
+			{
+				return slot;
+			}
+		}
+	}
+
+	size_t findCounter(const T& element, uint64_t hash) const
+	{
+		const uint32_t counterIdx = mTable[findSlot(element, hash)];
+		return counterIdx == EmptySlot ? NotFound : counterIdx;
+	}
+
+	template<typename E>
+	void countElement(E&& element, uint64_t hash, uint64_t count, uint64_t error)
+	{
+		const size_t slot = findSlot(element, hash);
+		uint32_t counterIdx = mTable[slot];
+
+		if (counterIdx != EmptySlot)
+		{
+			Counter& counter = mCounters[counterIdx];
+			counter.count += count;
+			counter.error += error;
+			siftDown(counter.heapPos);
+			return;
+		}
+
+		if (mCounters.size() < mHeavyHittersCount)
+		{
+			counterIdx = static_cast<uint32_t>(mCounters.size());
+			mCounters.push_back({T(std::forward<E>(element)), hash, count, error, static_cast<uint32_t>(mCountersHeap.size())});
+			mCountersHeap.push_back(counterIdx);
+			mTable[slot] = counterIdx;
+			siftUp(mCounters[counterIdx].heapPos);
+			return;
+		}
+
+		// the least frequent element gives its counter to the new one, which could have appeared up to that many times before
+		counterIdx = mCountersHeap[0];
+		Counter& counter = mCounters[counterIdx];
+		eraseSlot(findSlot(counter.element, counter.hash));
+		counter.element = std::forward<E>(element);
+		counter.hash = hash;
+		counter.error = counter.count + error;
+		counter.count += count;
+		mTable[findSlot(counter.element, hash)] = counterIdx;
+		siftDown(0);
+	}
+
+	// backward shift deletion, keeps the probe sequences of the other elements unbroken
+	void eraseSlot(size_t slot)
+	{
+		const size_t mask = mTable.size() - 1;
+		size_t next = (slot + 1) & mask;
+		while (mTable[next] != EmptySlot)
+		{
+			const size_t idealSlot = static_cast<size_t>(mCounters[mTable[next]].hash) & mask;
+			// move the element back if the freed slot is between its ideal slot and its current slot
+			if (((next - idealSlot) & mask) >= ((next - slot) & mask))
+			{
+				mTable[slot] = mTable[next];
+				slot = next;
+			}
+			next = (next + 1) & mask;
+		}
+		mTable[slot] = EmptySlot;
+	}
+
+	// min-heap of counter indexes by count, the counters know their positions to be moved when incremented
+	void swapHeapItems(size_t a, size_t b)
+	{
+		std::swap(mCountersHeap[a], mCountersHeap[b]);
+		mCounters[mCountersHeap[a]].heapPos = static_cast<uint32_t>(a);
+		mCounters[mCountersHeap[b]].heapPos = static_cast<uint32_t>(b);
+	}
+
+	uint64_t getHeapCount(size_t pos) const
+	{
+		return mCounters[mCountersHeap[pos]].count;
+	}
+
+	void siftUp(size_t pos)
+	{
+		while (pos > 0)
+		{
+			const size_t parent = (pos - 1) / 2;
+			if (getHeapCount(parent) <= getHeapCount(pos))
+			{
+				break;
+			}
+			swapHeapItems(parent, pos);
+			pos = parent;
+		}
+	}
+
+	void siftDown(size_t pos)
+	{
+		const size_t size = mCountersHeap.size();
+		while (true)
+		{
+			const size_t left = pos * 2 + 1;
+			if (left >= size)
+			{
+				break;
+			}
+			const size_t right = left + 1;
+			const size_t smallest = (right < size && getHeapCount(right) < getHeapCount(left)) ? right : left;
+			if (getHeapCount(pos) <= getHeapCount(smallest))
+			{
+				break;
+			}
+			swapHeapItems(pos, smallest);
+			pos = smallest;
+		}
+	}
+
+private:
+	Sampler mSampler;
+	const size_t mHeavyHittersCount;
+	Hash mHash;
+	KeyEqual mKeyEqual;
+	std::vector<Counter> mCounters;
+	std::vector<uint32_t> mCountersHeap;
+	std::vector<uint32_t> mTable;
+};
@@ -0,0 +1,284 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerIndexed samples weighted elements without replacement from a set of elements that is known beforehand
+// The weights are kept in a Fenwick tree, so sampling k elements takes O(k*log(n)) and changing a weight takes O(log(n))
+// The elements are selected one by one proportionally to their weights from the elements that are not selected yet,
+// which gives the same distribution as ReservoirSamplerWeighted would give over all the elements
+// The sums of weights are kept in double, call rebuild after a big amount of weight changes to get rid of the accumulated error
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+template<typename T, typename WeightType = float, typename URNG = std::mt19937, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerIndexed : private StatsPolicy
+{
+public:
+	// C++17 doesn't support std::span, so we can do this instead
+	struct ResultSpan
+	{
+		ResultSpan(T* data, size_t size)
+			: data(data)
+			, size(size)
+		{}
+
+		T* data;
+		size_t size;
+
+		T* begin() { return data; }
+		const T* begin() const { return data; }
+		T* end() { return data + size; }
+		const T* end() const { return data + size; }
+	};
+
+public:
+	// weights[i] is the weight of elements[i], the weights should not be negative
+	template<typename URNG_T = URNG>
+	ReservoirSamplerIndexed(size_t samplesCount, std::vector<T> elements, std::vector<WeightType> weights, URNG_T&& rand = URNG{std::random_device{}()})
+		: mSamplesCount(samplesCount)
+		, mRand(std::forward<URNG_T>(rand))
+		, mElements(std::move(elements))
+		, mWeights(std::move(weights))
+	{
+		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
+		assert(samplesCount > 0);
+		assert(mElements.size() == mWeights.size());
+		mResult.reserve(mSamplesCount);
+		mResultIndexes.reserve(mSamplesCount);
+		rebuild();
+	}
+
+	// selects samplesCount elements (or less if there are fewer elements with positive weights)
+	// the previous result is replaced
+	void sample()
+	{
+		sampleIndexes();
+		mResult.clear();
+		for (size_t index : mResultIndexes)
+		{
+			mResult.push_back(mElements[index]);
+			this->onConstruction();
+		}
+	}
+
+	ResultSpan getResult() const
+	{
+		return ResultSpan(const_cast<T*>(mResult.data()), mResult.size());
+	}
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result = std::move(mResult);
+		mResult.clear();
+		mResult.reserve(mSamplesCount);
+		return result;
+	}
+
+	size_t getResultSize() const { return mResult.size(); }
+
+	// indexes of the elements selected by the last call to sample
+	const std::vector<size_t>& getResultIndexes() const { return mResultIndexes; }
+
+	// sets the weight of the element at the given index
+	void setWeight(size_t index, WeightType weight)
+	{
+		assert(index < mWeights.size());
+		assert(weight >= 0);
+		addToTree(index, static_cast<double>(weight) - static_cast<double>(mWeights[index]));
+		mPositiveWeightsCount += static_cast<size_t>(weight > 0);
+		mPositiveWeightsCount -= static_cast<size_t>(mWeights[index] > 0);
+		mWeights[index] = weight;
+	}
+
+	WeightType getWeight(size_t index) const
+	{
+		assert(index < mWeights.size());
+		return mWeights[index];
+	}
+
+	size_t getElementsCount() const { return mElements.size(); }
+
+	const T& getElement(size_t index) const
+	{
+		assert(index < mElements.size());
+		return mElements[index];
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+	// recalculates the tree from the weights in O(n)
+	void rebuild()
+	{
+		const size_t count = mWeights.size();
+		mTree.assign(count + 1, 0.0);
+		mIsSelected.assign(count, false);
+		mPositiveWeightsCount = 0;
+		for (size_t i = 1; i <= count; ++i)
+		{
+			mPositiveWeightsCount += static_cast<size_t>(mWeights[i - 1] > 0);
+			mTree[i] += static_cast<double>(mWeights[i - 1]);
+			const size_t parent = i + (i & (~i + 1));
+			if (parent <= count)
+			{
+				mTree[parent] += mTree[i];
+			}
+		}
+
+		mHighestBit = 1;
+		while (mHighestBit * 2 <= count)
+		{
+			mHighestBit *= 2;
+		}
+	}
+
+private:
+	void sampleIndexes()
+	{
+		mResultIndexes.clear();
+
+		// the residue of the removed weights can keep the total above zero, so the count of selectable elements is used as the limit
+		const size_t resultSize = std::min(mSamplesCount, mPositiveWeightsCount);
+		while (mResultIndexes.size() < resultSize)
+		{
+			this->onRandomCall();
+			size_t index = findIndex(ReservoirSamplerUtils::generateUniform<double>(mRand) * getTotalWeight());
+			if (!isSelectable(index))
+			{
+				// can happen only because of rounding errors
+				index = findClosestSelectable(index);
+			}
+
+			mResultIndexes.push_back(index);
+			mIsSelected[index] = true;
+			// the selected elements are removed from the tree for the time of sampling, the old values are restored exactly after that
+			removeFromTree(index);
+		}
+
+		for (size_t i = mChangedNodes.size(); i > 0; --i)
+		{
+			mTree[mChangedNodes[i - 1].first] = mChangedNodes[i - 1].second;
+		}
+		mChangedNodes.clear();
+
+		for (size_t index : mResultIndexes)
+		{
+			mIsSelected[index] = false;
+		}
+	}
+
+	bool isSelectable(size_t index) const
+	{
+		return index < mWeights.size() && mWeights[index] > 0 && !mIsSelected[index];
+	}
+
+	// there is always a selectable element while the result is smaller than the count of positive weights
+	size_t findClosestSelectable(size_t index) const
+	{
+		const size_t count = mWeights.size();
+		for (size_t i = std::min(index, count); i > 0; --i)
+		{
+			if (isSelectable(i - 1))
+			{
+				return i - 1;
+			}
+		}
+		for (size_t i = index + 1; i < count; ++i)
+		{
+			if (isSelectable(i))
+			{
+				return i;
+			}
+		}
+		assert(false);
+		return 0;
+	}
+
+	double getTotalWeight() const
+	{
+		double sum = 0.0;
+		for (size_t i = mWeights.size(); i > 0; i -= (i & (~i + 1)))
+		{
+			sum += mTree[i];
+		}
+		return sum;
+	}
+
+	// returns the index of the element whose weight covers the given position in the sum of weights
+	size_t findIndex(double position) const
+	{
+		size_t index = 0;
+		for (size_t step = mHighestBit; step > 0; step >>= 1)
+		{
+			if (index + step < mTree.size() && mTree[index + step] <= position)
+			{
+				index += step;
+				position -= mTree[index];
+			}
+		}
+		return index;
+	}
+
+	void addToTree(size_t index, double delta)
+	{
+		for (size_t i = index + 1; i < mTree.size(); i += (i & (~i + 1)))
+		{
+			mTree[i] += delta;
+		}
+	}
+
+	void removeFromTree(size_t index)
+	{
+		const double weight = static_cast<double>(mWeights[index]);
+		for (size_t i = index + 1; i < mTree.size(); i += (i & (~i + 1)))
+		{
+			mChangedNodes.emplace_back(i, mTree[i]);
+			mTree[i] -= weight;
+		}
+	}
+
+private:
+	const size_t mSamplesCount;
+	URNG mRand;
+	std::vector<T> mElements;
+	std::vector<WeightType> mWeights;
+	// Fenwick tree with 1-based indexes, mTree[0] is not used
+	std::vector<double> mTree;
+	size_t mHighestBit = 1;
+	size_t mPositiveWeightsCount = 0;
+	// marks the elements of mResultIndexes while they are being selected
+	std::vector<bool> mIsSelected;
+	std::vector<T> mResult;
+	std::vector<size_t> mResultIndexes;
+	// the tree nodes changed during the sampling together with their old values
+	std::vector<std::pair<size_t, double>> mChangedNodes;
+};
@@ -22,25 +22,34 @@
 
 #pragma once
 
+#include <cstdint>
 #include <optional>
 #include <random>
 #include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_stats.h"
 
 // ReservoirSamplerLinear implements simple reservoir sampleing to get one element out of a stream
-// This sampler has linear complexity and ineffective for big streams, it also has potentiol to overflow
+// This sampler has linear complexity and ineffective for big streams, with integer weights it also has potentiol to overflow
 // and cause incorrect results or UB if used not carefully, however can be very efficient for small streams
+// WeightType can be an integer or a floating point type, see ReservoirSamplerLinearStatic for sampling more than one element
 //
 // Important: The sum of all weights that go through one instance of this class should fit into WeightType
 // Important: Very inefficient with big streams of elements, use other samplers for such cases
-template<typename T, typename WeightType = unsigned int, typename URNG = std::mt19937>
-class ReservoirSamplerLinear
+//
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+template<typename T, typename WeightType = unsigned int, typename URNG = std::mt19937, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerLinear : private StatsPolicy
 {
 public:
-	template<typename URNG_T = URNG, typename = std::enable_if_t<!std::is_same_v<std::decay_t<URNG_T>, ReservoirSamplerLinear<T, WeightType, URNG>>>>
-	explicit ReservoirSamplerLinear(URNG_T&& rand = std::mt19937{std::random_device{}()})
+	template<typename URNG_T = URNG, typename = std::enable_if_t<!std::is_same_v<std::decay_t<URNG_T>, ReservoirSamplerLinear<T, WeightType, URNG, StatsPolicy>>>>
+	explicit ReservoirSamplerLinear(URNG_T&& rand = URNG{std::random_device{}()})
 		: mRand(std::forward<URNG_T>(rand))
 	{
-		static_assert(std::is_integral_v<WeightType>, "WeightType should be arithmetic type");
+		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
 	}
 
 	~ReservoirSamplerLinear() = default;
@@ -48,7 +57,8 @@ public:
 	ReservoirSamplerLinear(const ReservoirSamplerLinear& other) = default;
 
 	ReservoirSamplerLinear(ReservoirSamplerLinear&& other) noexcept
-		: mWeightSum(other.mWeightSum)
+		: StatsPolicy(other)
+		, mWeightSum(other.mWeightSum)
 		, mSelectedElement(std::move(other.mSelectedElement))
 		, mRand(other.mRand)
 	{
@@ -59,6 +69,7 @@ public:
 
 	ReservoirSamplerLinear& operator=(ReservoirSamplerLinear&& other) noexcept
 	{
+		StatsPolicy::operator=(other);
 		mWeightSum = other.mWeightSum;
 		mSelectedElement = std::move(other.mSelectedElement);
 
@@ -101,12 +112,66 @@ public:
 		mSelectedElement = std::nullopt;
 	}
 
+	// writes the full state of the sampler including the state of the random generator and the element to the end of buffer
+	// Codec defines how the element is written, the default one copies the bytes of trivially copyable types
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Linear, 1);
+		writer.write(mWeightSum);
+		ReservoirSamplerUtils::writeRand(writer, mRand);
+		writer.write(static_cast<uint8_t>(mSelectedElement.has_value()));
+		if (mSelectedElement.has_value())
+		{
+			codec.write(writer, *mSelectedElement);
+		}
+	}
+
+	// restores the state written by serialize
+	// returns false if the data can't be read, in this case the sampler is left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		WeightType weightSum {};
+		uint8_t hasElement = 0;
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Linear, 1)
+			|| !reader.read(weightSum)
+			|| !ReservoirSamplerUtils::readRand(reader, mRand)
+			|| !reader.read(hasElement))
+		{
+			return false;
+		}
+
+		if (hasElement != 0)
+		{
+			mSelectedElement = codec.read(reader);
+			if (!mSelectedElement.has_value())
+			{
+				return false;
+			}
+		}
+
+		mWeightSum = weightSum;
+		return true;
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
 private:
 	template<bool isT, typename... Args>
 	void emplace(WeightType weight, Args&&... arguments)
 	{
+		this->onElementsSeen(1);
+
 		if (weight <= 0)
 		{
+			this->onElementsSkipped(1);
 			return;
 		}
 
@@ -114,30 +179,50 @@ private:
 		if (!mSelectedElement.has_value())
 		{
 			mSelectedElement.emplace(std::forward<Args>(arguments)...);
+			this->onConstruction();
 		}
 		else
 		{
-			if (static_cast<WeightType>(mRand() % mWeightSum) < weight)
+			this->onRandomCall();
+			if (isReplacing(weight))
 			{
 				replaceElement<isT>(std::forward<Args>(arguments)...);
 			}
 		}
 	}
 
+	// the new element replaces the selected one with probability weight/mWeightSum
+	bool isReplacing(WeightType weight)
+	{
+		if constexpr (std::is_floating_point_v<WeightType>)
+		{
+			return ReservoirSamplerUtils::generateUniform<WeightType>(mRand) * mWeightSum < weight;
+		}
+		else
+		{
+			// the bounded draw is done with a multiplication instead of a division
+			return static_cast<WeightType>(ReservoirSamplerUtils::generateBounded(mRand, static_cast<size_t>(mWeightSum))) < weight;
+		}
+	}
+
 	template<bool isT, typename... Args>
 	void replaceElement(Args&&... arguments)
 	{
 		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
 		{
 			mSelectedElement = std::forward<Args...>(arguments...);
+			this->onAssignment();
 		}
 		else if constexpr (std::is_move_assignable_v<T> && std::is_move_constructible_v<T>)
 		{
 			mSelectedElement = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
 		}
 		else
 		{
 			mSelectedElement.emplace(std::forward<Args>(arguments)...);
+			this->onConstruction();
 		}
 	}
 
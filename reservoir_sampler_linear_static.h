@@ -0,0 +1,296 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerLinearStatic implements Algorithm A-Res for weighted reservoir sampling
+// https://en.wikipedia.org/wiki/Reservoir_sampling#Algorithm_A-Res
+// The sampling is the same as in ReservoirSamplerWeightedStatic, but every element gets its own priority
+// instead of jumping over elements and the lowest priority is found with a linear scan instead of a heap
+// Every element costs a random draw, a log and a comparison with the lowest priority, and that comparison is a branch that is
+// mostly taken early in the stream and rarely taken later, without the jumps this is only faster for short streams and small SamplesCount
+// Objects of the class don't allocate memory on heap (unless stored types allocate data themselves)
+//
+// Important: Very inefficient with big streams of elements, use other samplers for such cases
+//
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+template<typename T, size_t SamplesCount, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerLinearStatic : private StatsPolicy
+{
+public:
+	// C++17 doesn't support std::span, so we can do this instead
+	struct ResultSpan
+	{
+		ResultSpan(T* data, size_t size)
+			: data(data)
+			, size(size)
+		{}
+
+		T* data;
+		size_t size;
+
+		T* begin() { return data; }
+		const T* begin() const { return data; }
+		T* end() { return data + size; }
+		const T* end() const { return data + size; }
+	};
+
+public:
+	template<typename URNG_T = URNG, typename = std::enable_if_t<!std::is_same_v<std::decay_t<URNG_T>, ReservoirSamplerLinearStatic<T, SamplesCount, WeightType, URNG, RandType, StatsPolicy>>>>
+	explicit ReservoirSamplerLinearStatic(URNG_T&& rand = URNG{std::random_device{}()})
+		: mRand(std::forward<URNG_T>(rand))
+	{
+		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		static_assert(SamplesCount > 0, "SamplesCount should not be zero");
+	}
+
+	~ReservoirSamplerLinearStatic()
+	{
+		reset();
+	}
+
+	ReservoirSamplerLinearStatic(const ReservoirSamplerLinearStatic& other)
+		: StatsPolicy(other)
+		, mRand(other.mRand)
+	{
+		copyFrom(other);
+	}
+
+	ReservoirSamplerLinearStatic(ReservoirSamplerLinearStatic&& other) noexcept
+		: StatsPolicy(other)
+		, mRand(other.mRand)
+	{
+		moveFrom(other);
+	}
+
+	ReservoirSamplerLinearStatic& operator=(const ReservoirSamplerLinearStatic& other)
+	{
+		reset();
+		StatsPolicy::operator=(other);
+		copyFrom(other);
+		return *this;
+	}
+
+	ReservoirSamplerLinearStatic& operator=(ReservoirSamplerLinearStatic&& other) noexcept
+	{
+		reset();
+		StatsPolicy::operator=(other);
+		moveFrom(other);
+		return *this;
+	}
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(WeightType weight, E&& element)
+	{
+		emplace<true>(weight, std::move(element));
+	}
+
+	void sampleElement(WeightType weight, const T& element)
+	{
+		emplace<true>(weight, std::ref(element));
+	}
+
+	template<typename... Args>
+	void sampleElementEmplace(WeightType weight, Args&&... arguments)
+	{
+		emplace<false>(weight, std::forward<Args>(arguments)...);
+	}
+
+	ResultSpan getResult() const
+	{
+		return ResultSpan(mElements, mFilledElementsCount);
+	}
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result(std::make_move_iterator(mElements), std::make_move_iterator(mElements + mFilledElementsCount));
+
+		reset();
+
+		return result;
+	}
+
+	size_t getResultSize() const { return mFilledElementsCount; }
+
+	// outRawData should point to a C-array with enough memory to fit getResultSize() elements
+	void consumeResultTo(T* outRawData)
+	{
+		std::move(mElements, mElements + mFilledElementsCount, outRawData);
+		reset();
+	}
+
+	// fully resets the state and cleans all the stored data, allowing to be reused for a new sampling
+	void reset()
+	{
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			mElements[i].~T();
+		}
+		mFilledElementsCount = 0;
+		mMinPriorityIndex = 0;
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+private:
+	template<bool isT, typename... Args>
+	void emplace(WeightType weight, Args&&... arguments)
+	{
+		this->onElementsSeen(1);
+
+		if (static_cast<RandType>(weight) <= static_cast<RandType>(0.0))
+		{
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		// the priorities are stored in log space (log(u^(1/w)) = log(u)/w), which avoids pow
+		this->onRandomCall();
+		const RandType r = std::log(ReservoirSamplerUtils::generateUniform<RandType>(mRand)) / static_cast<RandType>(weight);
+
+		// after filling, the acceptance is a branch and only the accepted elements pay for the replacement and the scan
+		if (mFilledElementsCount < SamplesCount)
+		{
+			mPriorities[mFilledElementsCount] = r;
+			new (mElements + mFilledElementsCount) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			++mFilledElementsCount;
+			if (mFilledElementsCount == SamplesCount)
+			{
+				updateMinPriorityIndex();
+			}
+		}
+		else if (r > mPriorities[mMinPriorityIndex])
+		{
+			mPriorities[mMinPriorityIndex] = r;
+			replaceElement<isT>(mMinPriorityIndex, std::forward<Args>(arguments)...);
+			updateMinPriorityIndex();
+		}
+		else
+		{
+			this->onElementsSkipped(1);
+		}
+	}
+
+	// a linear scan over a small fixed array, the selection compiles to conditional moves
+	void updateMinPriorityIndex()
+	{
+		size_t minIndex = 0;
+		for (size_t i = 1; i < SamplesCount; ++i)
+		{
+			minIndex = (mPriorities[i] < mPriorities[minIndex]) ? i : minIndex;
+		}
+		mMinPriorityIndex = minIndex;
+	}
+
+	template<bool isT, typename... Args>
+	void replaceElement(size_t pos, Args&&... arguments)
+	{
+		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
+		{
+			mElements[pos] = std::forward<Args...>(arguments...);
+			this->onAssignment();
+		}
+		else if constexpr (std::is_move_assignable_v<T>)
+		{
+			mElements[pos] = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
+		}
+		else
+		{
+			mElements[pos].~T();
+			new (mElements + pos) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+		}
+	}
+
+	void copyFrom(const ReservoirSamplerLinearStatic& other)
+	{
+		std::copy(other.mPriorities, other.mPriorities + other.mFilledElementsCount, mPriorities);
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			std::memcpy(mElements, other.mElements, sizeof(T)*other.mFilledElementsCount);
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				this->onConstruction();
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				new (mElements + i) T(other.mElements[i]);
+				this->onConstruction();
+			}
+		}
+		mFilledElementsCount = other.mFilledElementsCount;
+		mMinPriorityIndex = other.mMinPriorityIndex;
+	}
+
+	void moveFrom(ReservoirSamplerLinearStatic& other)
+	{
+		std::copy(other.mPriorities, other.mPriorities + other.mFilledElementsCount, mPriorities);
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			std::memcpy(mElements, other.mElements, sizeof(T)*other.mFilledElementsCount);
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				this->onConstruction();
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				new (mElements + i) T(std::move(other.mElements[i]));
+				this->onConstruction();
+			}
+		}
+		mFilledElementsCount = other.mFilledElementsCount;
+		mMinPriorityIndex = other.mMinPriorityIndex;
+		other.reset();
+	}
+
+private:
+	URNG mRand;
+	size_t mFilledElementsCount = 0;
+	size_t mMinPriorityIndex = 0;
+	RandType mPriorities[SamplesCount];
+	alignas(T) std::byte mData[sizeof(T)*SamplesCount];
+	T* const mElements = reinterpret_cast<T*>(mData);
+};
@@ -0,0 +1,415 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerMapped implements Algorithm L like ReservoirSampler, but keeps all its state in a memory-mapped file
+// This allows the reservoir to be bigger than RAM, the result can be read by other processes directly from the file,
+// and the sampling can be continued after a restart by opening the same file with the same parameters
+// T and URNG should be trivially copyable, as they are stored in the file as is
+// The file uses the native byte order and type sizes, so it should be opened by the same build on the same platform
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h, the stats are not stored in the file
+template<typename T, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerMapped : private StatsPolicy
+{
+public:
+	// C++17 doesn't support std::span, so we can do this instead
+	struct ResultSpan
+	{
+		ResultSpan(T* data, size_t size)
+			: data(data)
+			, size(size)
+		{}
+
+		T* data;
+		size_t size;
+
+		T* begin() { return data; }
+		const T* begin() const { return data; }
+		T* end() { return data + size; }
+		const T* end() const { return data + size; }
+	};
+
+	// the layout of the beginning of the file, the elements follow it at getElementsOffset()
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t elementSize;
+		uint64_t randTypeSize;
+		uint64_t urngSize;
+		uint64_t samplesCount;
+		uint64_t indexesToJumpOver;
+		uint64_t filledElementsCount;
+		uint64_t seenElementsCount;
+		RandType weightJumpOver;
+		URNG rand;
+	};
+
+	static constexpr uint32_t FileMagic = 0x504D5352; // "RSMP"
+	static constexpr uint32_t FileVersion = 2;
+
+public:
+	// opens the file at path, or creates it if it doesn't exist or was created with different parameters
+	// if the file contains a sampler with the same samples count, the sampling continues from its state
+	// check isOpen() to know if the file was opened successfully
+	template<typename URNG_T = URNG>
+	ReservoirSamplerMapped(const char* path, size_t samplesCount, URNG_T&& rand = URNG{std::random_device{}()})
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "T should be trivially copyable to be stored in a file");
+		static_assert(std::is_trivially_copyable_v<URNG>, "URNG should be trivially copyable to be stored in a file");
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		assert(samplesCount > 0);
+
+		if (!mapFile(path, getFileSize(samplesCount)))
+		{
+			return;
+		}
+
+		mHeader = static_cast<FileHeader*>(mMapping);
+		mElements = reinterpret_cast<T*>(static_cast<char*>(mMapping) + getElementsOffset());
+
+		if (!isValidHeader(*mHeader, samplesCount))
+		{
+			new (mHeader) FileHeader{FileMagic, FileVersion, sizeof(T), sizeof(RandType), sizeof(URNG), samplesCount, 0, 0, 0, RandType{}, URNG(std::forward<URNG_T>(rand))};
+		}
+	}
+
+	~ReservoirSamplerMapped()
+	{
+		unmapFile();
+	}
+
+	ReservoirSamplerMapped(const ReservoirSamplerMapped&) = delete;
+	ReservoirSamplerMapped& operator=(const ReservoirSamplerMapped&) = delete;
+	ReservoirSamplerMapped(ReservoirSamplerMapped&&) = delete;
+	ReservoirSamplerMapped& operator=(ReservoirSamplerMapped&&) = delete;
+
+	bool isOpen() const { return mMapping != nullptr; }
+
+	void sampleElement(const T& element)
+	{
+		assert(isOpen());
+		FileHeader& header = *mHeader;
+		++header.seenElementsCount;
+		this->onElementsSeen(1);
+
+		if (header.indexesToJumpOver > 0)
+		{
+			--header.indexesToJumpOver;
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		const size_t samplesCount = static_cast<size_t>(header.samplesCount);
+		if (header.filledElementsCount < samplesCount)
+		{
+			mElements[header.filledElementsCount] = element;
+			this->onAssignment();
+			++header.filledElementsCount;
+
+			if (header.filledElementsCount == samplesCount)
+			{
+				header.weightJumpOver = std::exp(std::log(generateUniform()) / samplesCount);
+				header.indexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), header.weightJumpOver);
+			}
+		}
+		else
+		{
+			size_t pos = 0;
+			if (samplesCount > 1)
+			{
+				this->onRandomCall();
+				pos = ReservoirSamplerUtils::generateBounded(header.rand, samplesCount);
+			}
+			mElements[pos] = element;
+			this->onAssignment();
+
+			header.weightJumpOver *= std::exp(std::log(generateUniform()) / samplesCount);
+			header.indexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), header.weightJumpOver);
+		}
+	}
+
+	// samples all the elements in [first, last), the skipped elements are jumped over without being read
+	template<typename It>
+	void sampleRange(It first, It last)
+	{
+		assert(isOpen());
+		if constexpr (!std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>)
+		{
+			// single-pass iterators can't be measured in advance, so they are walked one element at a time
+			for (; first != last; ++first)
+			{
+				if (willNextElementBeConsidered())
+				{
+					sampleElement(*first);
+				}
+				else
+				{
+					skipNextElement();
+				}
+			}
+		}
+		else
+		{
+			size_t elementsLeft = static_cast<size_t>(std::distance(first, last));
+			while (elementsLeft > 0)
+			{
+				if (mHeader->indexesToJumpOver == 0)
+				{
+					sampleElement(*first);
+					++first;
+					--elementsLeft;
+				}
+				else
+				{
+					const size_t skipAmount = static_cast<size_t>(std::min<uint64_t>(mHeader->indexesToJumpOver, elementsLeft));
+					std::advance(first, static_cast<typename std::iterator_traits<It>::difference_type>(skipAmount));
+					elementsLeft -= skipAmount;
+					mHeader->indexesToJumpOver -= skipAmount;
+					mHeader->seenElementsCount += skipAmount;
+					this->onElementsSeen(skipAmount);
+					this->onElementsSkipped(skipAmount);
+				}
+			}
+		}
+	}
+
+	ResultSpan getResult() const
+	{
+		assert(isOpen());
+		return ResultSpan(mElements, static_cast<size_t>(mHeader->filledElementsCount));
+	}
+
+	// a sampler that failed to open has an empty result
+	size_t getResultSize() const { return isOpen() ? static_cast<size_t>(mHeader->filledElementsCount) : 0; }
+
+	size_t getSeenElementsCount() const { return isOpen() ? static_cast<size_t>(mHeader->seenElementsCount) : 0; }
+
+	// optionally use this function in combination with skipNextElement in case creation of an object is expensive
+	// you can call skipNextElement every time this method returns false as in these cases the objects will be skipped
+	bool willNextElementBeConsidered() const
+	{
+		assert(isOpen());
+		return mHeader->indexesToJumpOver == 0;
+	}
+
+	// optionally use this in combination with willNextElementBeConsidered, refer to the comment above willNextElementBeConsidered
+	void skipNextElement()
+	{
+		assert(isOpen());
+		assert(!willNextElementBeConsidered());
+		--mHeader->indexesToJumpOver;
+		++mHeader->seenElementsCount;
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+	// resets the state, allowing to be reused for a new sampling (the elements stay in the file but are not a part of the result)
+	void reset()
+	{
+		assert(isOpen());
+		mHeader->indexesToJumpOver = 0;
+		mHeader->filledElementsCount = 0;
+		mHeader->seenElementsCount = 0;
+		mHeader->weightJumpOver = {};
+	}
+
+	// synchronously writes the changes to the file, otherwise they are written by the OS at some point later
+	bool flush()
+	{
+		assert(isOpen());
+#ifdef _WIN32
+		return FlushViewOfFile(mMapping, 0) != 0;
+#else
+		return msync(mMapping, mMappingSize, MS_SYNC) == 0;
+#endif
+	}
+
+	// offset of the elements from the beginning of the file
+	static constexpr size_t getElementsOffset()
+	{
+		constexpr size_t alignment = std::alignment_of_v<T>;
+		return (sizeof(FileHeader) + alignment - 1) / alignment * alignment;
+	}
+
+	static constexpr size_t getFileSize(size_t samplesCount)
+	{
+		return getElementsOffset() + sizeof(T)*samplesCount;
+	}
+
+private:
+	// the file can be left from a different build or be damaged, so the state is used only if it is consistent
+	static bool isValidHeader(const FileHeader& header, size_t samplesCount)
+	{
+		if (header.magic != FileMagic
+			|| header.version != FileVersion
+			|| header.elementSize != sizeof(T)
+			|| header.randTypeSize != sizeof(RandType)
+			|| header.urngSize != sizeof(URNG)
+			|| header.samplesCount != samplesCount
+			|| header.filledElementsCount > header.samplesCount
+			|| header.seenElementsCount < header.filledElementsCount)
+		{
+			return false;
+		}
+
+		if (header.filledElementsCount < header.samplesCount)
+		{
+			// no elements are skipped until the reservoir is filled
+			return header.indexesToJumpOver == 0 && header.seenElementsCount == header.filledElementsCount;
+		}
+
+		return header.weightJumpOver > RandType(0) && header.weightJumpOver <= RandType(1);
+	}
+
+	bool mapFile(const char* path, size_t size)
+	{
+#ifdef _WIN32
+		mFile = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (mFile == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		const DWORD sizeHigh = static_cast<DWORD>(static_cast<uint64_t>(size) >> 32);
+		const DWORD sizeLow = static_cast<DWORD>(size & 0xFFFFFFFFu);
+		mFileMapping = CreateFileMappingA(mFile, nullptr, PAGE_READWRITE, sizeHigh, sizeLow, nullptr);
+		if (mFileMapping == nullptr)
+		{
+			unmapFile();
+			return false;
+		}
+
+		mMapping = MapViewOfFile(mFileMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (mMapping == nullptr)
+		{
+			unmapFile();
+			return false;
+		}
+#else
+		mFile = open(path, O_RDWR | O_CREAT, 0644);
+		if (mFile < 0)
+		{
+			return false;
+		}
+
+		// the size of the file is changed only if it doesn't match, so the existing data is kept
+		struct stat fileStat;
+		if (fstat(mFile, &fileStat) != 0 || (static_cast<size_t>(fileStat.st_size) != size && ftruncate(mFile, static_cast<off_t>(size)) != 0))
+		{
+			unmapFile();
+			return false;
+		}
+
+		void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+		if (mapping == MAP_FAILED)
+		{
+			unmapFile();
+			return false;
+		}
+		mMapping = mapping;
+#endif
+		mMappingSize = size;
+		this->onAllocation();
+		return true;
+	}
+
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mHeader->rand);
+	}
+
+	void unmapFile()
+	{
+#ifdef _WIN32
+		if (mMapping != nullptr)
+		{
+			UnmapViewOfFile(mMapping);
+		}
+		if (mFileMapping != nullptr)
+		{
+			CloseHandle(mFileMapping);
+		}
+		if (mFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(mFile);
+		}
+		mFileMapping = nullptr;
+		mFile = INVALID_HANDLE_VALUE;
+#else
+		if (mMapping != nullptr)
+		{
+			munmap(mMapping, mMappingSize);
+		}
+		if (mFile >= 0)
+		{
+			close(mFile);
+		}
+		mFile = -1;
+#endif
+		mMapping = nullptr;
+		mHeader = nullptr;
+		mElements = nullptr;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mFileMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+	void* mMapping = nullptr;
+	size_t mMappingSize = 0;
+	FileHeader* mHeader = nullptr;
+	T* mElements = nullptr;
+};
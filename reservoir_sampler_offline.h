@@ -0,0 +1,117 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "reservoir_sampler.h"
+
+// Helpers for sampling inputs that are fully available beforehand, e.g. random-access containers or files with fixed-size records
+// Instead of going through the elements they generate the selected indexes with the same exponential jumps
+// that ReservoirSampler uses and access only the selected elements
+namespace ReservoirSamplerUtils
+{
+	// returns samplesCount (or n if it is smaller) uniformly selected distinct indexes in the range [0, n) sorted in ascending order
+	// takes O(k*(1 + log(n/k))) random calls and doesn't depend on n otherwise
+	// RandType is double by default, with float the jumps over ranges of billions of indexes lose precision
+	template<typename RandType = double, typename URNG>
+	std::vector<size_t> sampleIndices(size_t n, size_t samplesCount, URNG& rand)
+	{
+		if (n == 0 || samplesCount == 0)
+		{
+			return {};
+		}
+
+		ReservoirSampler<size_t, URNG&, RandType> sampler{samplesCount, rand};
+		size_t index = 0;
+		while (index < n)
+		{
+			sampler.sampleElement(index);
+			const size_t skipAmount = std::min(sampler.getNextSkippedElementsCount(), n - index - 1);
+			sampler.jumpAhead(skipAmount);
+			index += skipAmount + 1;
+		}
+
+		std::vector<size_t> indices = sampler.consumeResult();
+		std::sort(indices.begin(), indices.end());
+		return indices;
+	}
+
+	// returns copies of samplesCount uniformly selected elements from a random-access range, in the order they appear in the range
+	template<typename RandType = double, typename RandomIt, typename URNG>
+	std::vector<typename std::iterator_traits<RandomIt>::value_type> sampleRandomAccess(RandomIt first, RandomIt last, size_t samplesCount, URNG& rand)
+	{
+		const std::vector<size_t> indices = sampleIndices<RandType>(static_cast<size_t>(std::distance(first, last)), samplesCount, rand);
+
+		std::vector<typename std::iterator_traits<RandomIt>::value_type> result;
+		result.reserve(indices.size());
+		for (size_t index : indices)
+		{
+			result.push_back(first[index]);
+		}
+		return result;
+	}
+
+	// reads samplesCount uniformly selected records of recordSize bytes from the file and appends them to outRecords,
+	// in the order they appear in the file, the bytes in the end of the file that don't form a full record are ignored
+	// only the selected records are read, the reads go forward through the file
+	// returns false if the file can't be read, in this case outRecords can contain part of the records
+	template<typename RandType = double, typename URNG>
+	bool sampleFileRecords(const char* path, size_t recordSize, size_t samplesCount, URNG& rand, std::vector<std::byte>& outRecords)
+	{
+		assert(recordSize > 0);
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+
+		const std::streamoff fileSize = file.tellg();
+		if (fileSize < 0)
+		{
+			return false;
+		}
+
+		const std::vector<size_t> indices = sampleIndices<RandType>(static_cast<size_t>(fileSize) / recordSize, samplesCount, rand);
+
+		const size_t oldSize = outRecords.size();
+		outRecords.resize(oldSize + indices.size()*recordSize);
+		std::byte* record = outRecords.data() + oldSize;
+		for (size_t index : indices)
+		{
+			file.seekg(static_cast<std::streamoff>(index*recordSize));
+			if (!file.read(reinterpret_cast<char*>(record), static_cast<std::streamsize>(recordSize)))
+			{
+				return false;
+			}
+			record += recordSize;
+		}
+		return true;
+	}
+}
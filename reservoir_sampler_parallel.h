@@ -0,0 +1,124 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+#include "reservoir_sampler.h"
+#include "reservoir_sampler_weighted.h"
+
+// Helpers for sampling one big random-access range on several threads
+// The range is split into chunks that are sampled by separate samplers with std::for_each and the given execution policy,
+// then the samplers are merged, which gives the same distribution as sampling the whole range with one sampler
+// Note that some standard library implementations require linking with an additional library (e.g. TBB) for the parallel policies
+namespace ReservoirSamplerUtils
+{
+	// the chunks are not made smaller than this, so small ranges are not split into too many chunks
+	constexpr size_t ParallelMinChunkSize = 1 << 16;
+	// enough chunks to keep the threads busy while keeping the merging cheap
+	constexpr size_t ParallelMaxChunksCount = 256;
+
+	// the amount of chunks depends only on the size of the range and not on the amount of threads,
+	// so with the same random generator the result is the same on any machine
+	inline size_t getParallelChunksCount(size_t elementsCount)
+	{
+		return std::max<size_t>(1, std::min(ParallelMaxChunksCount, elementsCount / ParallelMinChunkSize));
+	}
+
+	// calls sampleChunk(sampler, chunkFirst, chunkLast) for every chunk in parallel and merges the samplers
+	// the samplers get substreams of rand if the generator can be split (see Philox4x32), otherwise their generators are seeded from one value of rand
+	template<typename Sampler, typename ExecutionPolicy, typename RandomIt, typename URNG, typename ChunkFunc>
+	Sampler sampleChunksParallel(ExecutionPolicy&& policy, RandomIt first, RandomIt last, size_t samplesCount, URNG& rand, ChunkFunc&& sampleChunk)
+	{
+		const size_t elementsCount = static_cast<size_t>(std::distance(first, last));
+		const size_t chunksCount = getParallelChunksCount(elementsCount);
+
+		std::vector<Sampler> samplers;
+		samplers.reserve(chunksCount);
+		// one value is taken from rand in any case, so the next call gets different substreams
+		const uint64_t streamsSeed = static_cast<uint64_t>(rand());
+		for (size_t i = 0; i < chunksCount; ++i)
+		{
+			if constexpr (IsSplittable<URNG>::value)
+			{
+				samplers.emplace_back(samplesCount, rand.split(streamsSeed).split(i));
+			}
+			else
+			{
+				samplers.emplace_back(samplesCount, URNG(static_cast<typename URNG::result_type>(SplitMix64::mix(streamsSeed + i))));
+			}
+		}
+
+		std::vector<size_t> chunkIndexes(chunksCount);
+		std::iota(chunkIndexes.begin(), chunkIndexes.end(), size_t(0));
+		std::for_each(std::forward<ExecutionPolicy>(policy), chunkIndexes.begin(), chunkIndexes.end(), [&](size_t chunk) {
+			const RandomIt chunkFirst = first + static_cast<std::ptrdiff_t>(elementsCount * chunk / chunksCount);
+			const RandomIt chunkLast = first + static_cast<std::ptrdiff_t>(elementsCount * (chunk + 1) / chunksCount);
+			std::invoke(sampleChunk, samplers[chunk], chunkFirst, chunkLast);
+		});
+
+		for (size_t i = 1; i < chunksCount; ++i)
+		{
+			samplers[0].merge(samplers[i]);
+		}
+		return std::move(samplers[0]);
+	}
+
+	// returns copies of samplesCount uniformly selected elements of the range
+	template<typename RandType = float, typename ExecutionPolicy, typename RandomIt, typename URNG>
+	std::vector<typename std::iterator_traits<RandomIt>::value_type> parallelSample(ExecutionPolicy&& policy, RandomIt first, RandomIt last, size_t samplesCount, URNG& rand)
+	{
+		using Sampler = ReservoirSampler<typename std::iterator_traits<RandomIt>::value_type, URNG, RandType>;
+		return sampleChunksParallel<Sampler>(std::forward<ExecutionPolicy>(policy), first, last, samplesCount, rand, [](Sampler& sampler, RandomIt chunkFirst, RandomIt chunkLast) {
+			// jumps over the skipped elements without accessing them
+			sampler.sampleRange(chunkFirst, chunkLast);
+		}).consumeResult();
+	}
+
+	// returns copies of samplesCount elements of the range selected with weights, weightFunc(element) should return the weight of the element
+	template<typename WeightType = float, typename RandType = float, typename ExecutionPolicy, typename RandomIt, typename WeightFunc, typename URNG>
+	std::vector<typename std::iterator_traits<RandomIt>::value_type> parallelSampleWeighted(ExecutionPolicy&& policy, RandomIt first, RandomIt last, size_t samplesCount, WeightFunc&& weightFunc, URNG& rand)
+	{
+		using Sampler = ReservoirSamplerWeighted<typename std::iterator_traits<RandomIt>::value_type, WeightType, URNG, RandType>;
+		return sampleChunksParallel<Sampler>(std::forward<ExecutionPolicy>(policy), first, last, samplesCount, rand, [&weightFunc](Sampler& sampler, RandomIt chunkFirst, RandomIt chunkLast) {
+			for (RandomIt it = chunkFirst; it != chunkLast; ++it)
+			{
+				const WeightType weight = static_cast<WeightType>(std::invoke(weightFunc, *it));
+				if (sampler.willNextElementBeConsidered(weight))
+				{
+					sampler.sampleElement(weight, *it);
+				}
+				else
+				{
+					sampler.skipNextElement(weight);
+				}
+			}
+		}).consumeResult();
+	}
+}
@@ -0,0 +1,418 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerPool implements Algorithm L for many independent streams (groups) at once
+// e.g. to sample k elements per key, where the keys are mapped to group indexes by the caller
+// All the groups share one random generator and one allocation for all the elements,
+// the per-group state is stored in separate dense arrays, so the check for skipping an element touches only one value
+// The groups can have different samples counts, ReservoirSamplerStratified builds on top of that
+// StatsPolicy allows to collect stats about the sampling of all the groups together, see reservoir_sampler_stats.h
+template<typename T, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerPool : private StatsPolicy
+{
+public:
+	// C++17 doesn't support std::span, so we can do this instead
+	struct ResultSpan
+	{
+		ResultSpan(T* data, size_t size)
+			: data(data)
+			, size(size)
+		{}
+
+		T* data;
+		size_t size;
+
+		T* begin() { return data; }
+		const T* begin() const { return data; }
+		T* end() { return data + size; }
+		const T* end() const { return data + size; }
+	};
+
+public:
+	template<typename URNG_T = URNG>
+	ReservoirSamplerPool(size_t groupsCount, size_t samplesCount, URNG_T&& rand = URNG{std::random_device{}()})
+		: ReservoirSamplerPool(std::vector<size_t>(groupsCount, samplesCount), std::forward<URNG_T>(rand))
+	{
+	}
+
+	// samplesCounts contains the samples count for every group
+	template<typename URNG_T = URNG>
+	explicit ReservoirSamplerPool(const std::vector<size_t>& samplesCounts, URNG_T&& rand = URNG{std::random_device{}()})
+		: mGroupsCount(samplesCounts.size())
+		, mRand(std::forward<URNG_T>(rand))
+		, mOffsets(samplesCounts.size() + 1, 0)
+		, mIndexesToJumpOver(samplesCounts.size(), 0)
+		, mWeightJumpOver(samplesCounts.size(), RandType{})
+		, mFilledElementsCount(samplesCounts.size(), 0)
+	{
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		assert(mGroupsCount > 0);
+		for (size_t group = 0; group < mGroupsCount; ++group)
+		{
+			assert(samplesCounts[group] > 0);
+			mOffsets[group + 1] = mOffsets[group] + samplesCounts[group];
+		}
+		allocateData();
+	}
+
+	~ReservoirSamplerPool()
+	{
+		if (mElements != nullptr)
+		{
+			reset();
+			std::allocator<T>().deallocate(mElements, getTotalSamplesCount());
+		}
+	}
+
+	ReservoirSamplerPool(const ReservoirSamplerPool& other)
+		: StatsPolicy(other)
+		, mGroupsCount(other.mGroupsCount)
+		, mRand(other.mRand)
+		, mOffsets(other.mOffsets)
+		, mIndexesToJumpOver(other.mIndexesToJumpOver)
+		, mWeightJumpOver(other.mWeightJumpOver)
+		, mFilledElementsCount(other.mFilledElementsCount)
+	{
+		allocateData();
+		for (size_t group = 0; group < mGroupsCount; ++group)
+		{
+			T* elements = getGroupElements(group);
+			const T* otherElements = other.getGroupElements(group);
+			for (size_t i = 0; i < mFilledElementsCount[group]; ++i)
+			{
+				new (elements + i) T(otherElements[i]);
+				this->onConstruction();
+			}
+		}
+	}
+
+	// the moved-from pool is left without groups, it can only be destroyed or reset
+	ReservoirSamplerPool(ReservoirSamplerPool&& other) noexcept
+		: StatsPolicy(std::move(other))
+		, mGroupsCount(other.mGroupsCount)
+		, mRand(std::move(other.mRand))
+		, mOffsets(std::move(other.mOffsets))
+		, mIndexesToJumpOver(std::move(other.mIndexesToJumpOver))
+		, mWeightJumpOver(std::move(other.mWeightJumpOver))
+		, mFilledElementsCount(std::move(other.mFilledElementsCount))
+		, mElements(other.mElements)
+	{
+		other.mGroupsCount = 0;
+		other.mElements = nullptr;
+	}
+
+	ReservoirSamplerPool& operator=(const ReservoirSamplerPool&) = delete;
+	ReservoirSamplerPool& operator=(ReservoirSamplerPool&&) noexcept = delete;
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(size_t groupIndex, E&& element)
+	{
+		emplace<true>(groupIndex, std::move(element));
+	}
+
+	void sampleElement(size_t groupIndex, const T& element)
+	{
+		emplace<true>(groupIndex, std::ref(element));
+	}
+
+	template<typename... Args>
+	void sampleElementEmplace(size_t groupIndex, Args&&... arguments)
+	{
+		emplace<false>(groupIndex, std::forward<Args>(arguments)...);
+	}
+
+	ResultSpan getResult(size_t groupIndex) const
+	{
+		assert(groupIndex < mGroupsCount);
+		return ResultSpan(getGroupElements(groupIndex), mFilledElementsCount[groupIndex]);
+	}
+
+	std::vector<T> consumeResult(size_t groupIndex)
+	{
+		assert(groupIndex < mGroupsCount);
+		T* elements = getGroupElements(groupIndex);
+		std::vector<T> result;
+		result.reserve(mFilledElementsCount[groupIndex]);
+		std::move(elements, elements + mFilledElementsCount[groupIndex], std::back_inserter(result));
+
+		reset(groupIndex);
+
+		return result;
+	}
+
+	size_t getResultSize(size_t groupIndex) const
+	{
+		assert(groupIndex < mGroupsCount);
+		return mFilledElementsCount[groupIndex];
+	}
+
+	size_t getSamplesCount(size_t groupIndex) const
+	{
+		assert(groupIndex < mGroupsCount);
+		return mOffsets[groupIndex + 1] - mOffsets[groupIndex];
+	}
+
+	size_t getGroupsCount() const { return mGroupsCount; }
+
+	// fully resets the state of one group and cleans its stored data
+	void reset(size_t groupIndex)
+	{
+		assert(groupIndex < mGroupsCount);
+		T* elements = getGroupElements(groupIndex);
+		for (size_t i = 0; i < mFilledElementsCount[groupIndex]; ++i)
+		{
+			elements[i].~T();
+		}
+		mIndexesToJumpOver[groupIndex] = 0;
+		mWeightJumpOver[groupIndex] = {};
+		mFilledElementsCount[groupIndex] = 0;
+	}
+
+	// fully resets the state of all the groups and cleans all the stored data
+	void reset()
+	{
+		for (size_t group = 0; group < mGroupsCount; ++group)
+		{
+			reset(group);
+		}
+	}
+
+	// optionally use this function in combination with skipNextElement in case creation of an object is expensive
+	// you can call skipNextElement every time this method returns false as in these cases the objects will be skipped
+	bool willNextElementBeConsidered(size_t groupIndex) const
+	{
+		assert(groupIndex < mGroupsCount);
+		return mIndexesToJumpOver[groupIndex] == 0;
+	}
+
+	// optionally use this in combination with willNextElementBeConsidered, refer to the comment above willNextElementBeConsidered
+	void skipNextElement(size_t groupIndex)
+	{
+		assert(!willNextElementBeConsidered(groupIndex));
+		--mIndexesToJumpOver[groupIndex];
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
+	}
+
+	// writes the full state of all the groups including the state of the random generator and the elements to the end of buffer
+	// Codec defines how the elements are written, the default one copies the bytes of trivially copyable types
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Pool, getTotalSamplesCount());
+		writeGroups(writer, codec);
+	}
+
+	// restores the state written by serialize, the pool should have the same samples counts of the groups
+	// returns false if the data can't be read, in this case all the groups are left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		return ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Pool, getTotalSamplesCount())
+			&& readGroups(reader, codec);
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+protected:
+	template<typename Codec>
+	void writeGroups(ReservoirSamplerUtils::BinaryWriter& writer, const Codec& codec) const
+	{
+		writer.write(mGroupsCount);
+		ReservoirSamplerUtils::writeRand(writer, mRand);
+		for (size_t group = 0; group < mGroupsCount; ++group)
+		{
+			writer.write(getSamplesCount(group));
+			writer.write(mIndexesToJumpOver[group]);
+			writer.write(mWeightJumpOver[group]);
+			writer.write(mFilledElementsCount[group]);
+			ReservoirSamplerUtils::writeElements(writer, getGroupElements(group), mFilledElementsCount[group], codec);
+		}
+	}
+
+	// should be called on a reset pool, resets it again if the data can't be read
+	template<typename Codec>
+	bool readGroups(ReservoirSamplerUtils::BinaryReader& reader, const Codec& codec)
+	{
+		size_t groupsCount = 0;
+		if (!reader.read(groupsCount)
+			|| groupsCount != mGroupsCount
+			|| !ReservoirSamplerUtils::readRand(reader, mRand))
+		{
+			return false;
+		}
+
+		for (size_t group = 0; group < mGroupsCount; ++group)
+		{
+			size_t samplesCount = 0;
+			size_t indexesToJumpOver = 0;
+			RandType weightJumpOver {};
+			size_t filledElementsCount = 0;
+			if (!reader.read(samplesCount)
+				|| samplesCount != getSamplesCount(group)
+				|| !reader.read(indexesToJumpOver)
+				|| !reader.read(weightJumpOver)
+				|| !reader.read(filledElementsCount)
+				|| filledElementsCount > samplesCount)
+			{
+				reset();
+				return false;
+			}
+
+			mFilledElementsCount[group] = ReservoirSamplerUtils::readElements(reader, getGroupElements(group), filledElementsCount, codec);
+			if (mFilledElementsCount[group] != filledElementsCount)
+			{
+				reset();
+				return false;
+			}
+
+			mIndexesToJumpOver[group] = indexesToJumpOver;
+			mWeightJumpOver[group] = weightJumpOver;
+		}
+		return true;
+	}
+
+	void allocateData()
+	{
+		mElements = std::allocator<T>().allocate(getTotalSamplesCount());
+		this->onAllocation();
+	}
+
+	size_t getTotalSamplesCount() const
+	{
+		return mOffsets[mGroupsCount];
+	}
+
+	T* getGroupElements(size_t groupIndex) const
+	{
+		return mElements + mOffsets[groupIndex];
+	}
+
+	template<bool isT, typename... Args>
+	void emplace(size_t groupIndex, Args&&... arguments)
+	{
+		assert(groupIndex < mGroupsCount);
+		this->onElementsSeen(1);
+
+		size_t& indexesToJumpOver = mIndexesToJumpOver[groupIndex];
+		if (indexesToJumpOver > 0)
+		{
+			--indexesToJumpOver;
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		T* elements = getGroupElements(groupIndex);
+		const size_t samplesCount = getSamplesCount(groupIndex);
+		size_t& filledElementsCount = mFilledElementsCount[groupIndex];
+		RandType& weightJumpOver = mWeightJumpOver[groupIndex];
+
+		if (filledElementsCount < samplesCount)
+		{
+			new (elements + filledElementsCount) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			++filledElementsCount;
+
+			if (filledElementsCount == samplesCount)
+			{
+				weightJumpOver = std::exp(std::log(generateUniform()) / samplesCount);
+				indexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), weightJumpOver);
+			}
+		}
+		else
+		{
+			const size_t pos = samplesCount > 1 ? generateBounded(samplesCount) : 0;
+			replaceElement<isT>(elements + pos, std::forward<Args>(arguments)...);
+
+			weightJumpOver *= std::exp(std::log(generateUniform()) / samplesCount);
+			indexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), weightJumpOver);
+		}
+	}
+
+	template<bool isT, typename... Args>
+	void replaceElement(T* element, Args&&... arguments)
+	{
+		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
+		{
+			*element = std::forward<Args...>(arguments...);
+			this->onAssignment();
+		}
+		else if constexpr (std::is_move_assignable_v<T>)
+		{
+			*element = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
+		}
+		else
+		{
+			element->~T();
+			new (element) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+		}
+	}
+
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mRand);
+	}
+
+	size_t generateBounded(size_t bound)
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateBounded(mRand, bound);
+	}
+
+protected:
+	size_t mGroupsCount;
+	URNG mRand;
+	// the state of the groups is stored as structure of arrays
+	// mOffsets[i] is the position of the first element of group i in mElements
+	std::vector<size_t> mOffsets;
+	std::vector<size_t> mIndexesToJumpOver;
+	// W of Algorithm L, the derived samplers can use it for other kinds of jumps
+	std::vector<RandType> mWeightJumpOver;
+	std::vector<size_t> mFilledElementsCount;
+	T* mElements = nullptr;
+};
@@ -0,0 +1,353 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+// Helpers for the random number generation used by the samplers
+// and small fast random generators that can be used as URNG instead of std::mt19937
+namespace ReservoirSamplerUtils
+{
+	// SplitMix64, used to seed the other generators, can also be used on its own (8 bytes of state)
+	// https://prng.di.unimi.it/splitmix64.c
+	class SplitMix64
+	{
+	public:
+		using result_type = uint64_t;
+
+	public:
+		explicit SplitMix64(uint64_t seed = 0)
+			: mState(seed)
+		{}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		result_type operator()()
+		{
+			return mix(mState += 0x9e3779b97f4a7c15ULL);
+		}
+
+		// the output function of SplitMix64, can be used on its own to mix the bits of a weak hash
+		static constexpr uint64_t mix(uint64_t z)
+		{
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+
+	private:
+		uint64_t mState;
+	};
+
+	// xoshiro256**, fast general purpose generator with 32 bytes of state
+	// https://prng.di.unimi.it/xoshiro256starstar.c
+	class Xoshiro256StarStar
+	{
+	public:
+		using result_type = uint64_t;
+
+	public:
+		explicit Xoshiro256StarStar(uint64_t seed = 0)
+		{
+			SplitMix64 seeder{seed};
+			for (uint64_t& s : mState)
+			{
+				s = seeder();
+			}
+		}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		result_type operator()()
+		{
+			const uint64_t result = rotl(mState[1] * 5, 7) * 9;
+			const uint64_t t = mState[1] << 17;
+
+			mState[2] ^= mState[0];
+			mState[3] ^= mState[1];
+			mState[1] ^= mState[2];
+			mState[0] ^= mState[3];
+
+			mState[2] ^= t;
+			mState[3] = rotl(mState[3], 45);
+
+			return result;
+		}
+
+	private:
+		static uint64_t rotl(uint64_t x, int k)
+		{
+			return (x << k) | (x >> (64 - k));
+		}
+
+	private:
+		uint64_t mState[4];
+	};
+
+	// PCG32 (XSH-RR variant), fast generator with 16 bytes of state producing 32-bit values
+	// https://www.pcg-random.org/
+	class Pcg32
+	{
+	public:
+		using result_type = uint32_t;
+
+	public:
+		explicit Pcg32(uint64_t seed = 0, uint64_t stream = 0xda3e39cb94b95bdbULL)
+			: mIncrement((stream << 1u) | 1u)
+		{
+			(*this)();
+			mState += seed;
+			(*this)();
+		}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		result_type operator()()
+		{
+			const uint64_t oldState = mState;
+			mState = oldState * 6364136223846793005ULL + mIncrement;
+			const uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+			const uint32_t rotation = static_cast<uint32_t>(oldState >> 59u);
+			return (xorShifted >> rotation) | (xorShifted << ((~rotation + 1u) & 31u));
+		}
+
+	private:
+		uint64_t mState = 0;
+		uint64_t mIncrement;
+	};
+
+	// Philox4x32-10, counter-based generator producing 32-bit values (https://www.thesalmons.org/john/random123/papers/random123sc11.pdf)
+	// every output block is a function of the key (seed) and the counter, so the generator can be split into
+	// independent substreams and moved forward in constant time, which gives reproducible results of parallel sampling
+	// the 128-bit counter consists of the index of the block in the lower half and the index of the stream in the upper half
+	class Philox4x32
+	{
+	public:
+		using result_type = uint32_t;
+
+	public:
+		explicit Philox4x32(uint64_t seed = 0, uint64_t stream = 0)
+			: mKey{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}
+			, mStream(stream)
+		{}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		result_type operator()()
+		{
+			if (mOutputIndex == 4)
+			{
+				generateBlock(mBlockIndex++, mOutput);
+				mOutputIndex = 0;
+			}
+			return mOutput[mOutputIndex++];
+		}
+
+		// returns the generator of substream with the given index, the result depends only on the seed,
+		// the stream of this generator and the index, so it is the same no matter when and on which thread it is called
+		Philox4x32 split(uint64_t index) const
+		{
+			Philox4x32 result(*this);
+			result.mStream = SplitMix64::mix(mStream ^ SplitMix64::mix(index + 1));
+			result.mBlockIndex = 0;
+			result.mOutputIndex = 4;
+			return result;
+		}
+
+		// skips count values in constant time
+		void discard(uint64_t count)
+		{
+			const uint64_t position = mBlockIndex*4 - (4 - mOutputIndex) + count;
+			mBlockIndex = position / 4;
+			mOutputIndex = 4;
+			if (position % 4 != 0)
+			{
+				generateBlock(mBlockIndex++, mOutput);
+				mOutputIndex = static_cast<uint32_t>(position % 4);
+			}
+		}
+
+		// writes the 4 values of the block with the given index of this stream, doesn't change the state
+		void generateBlock(uint64_t blockIndex, uint32_t (&outValues)[4]) const
+		{
+			uint32_t counter[4] = {static_cast<uint32_t>(blockIndex), static_cast<uint32_t>(blockIndex >> 32), static_cast<uint32_t>(mStream), static_cast<uint32_t>(mStream >> 32)};
+			uint32_t key[2] = {mKey[0], mKey[1]};
+			for (int round = 0; round < 10; ++round)
+			{
+				const uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * counter[0];
+				const uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * counter[2];
+				const uint32_t newCounter[4] = {
+					static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+					static_cast<uint32_t>(product1),
+					static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+					static_cast<uint32_t>(product0),
+				};
+				counter[0] = newCounter[0];
+				counter[1] = newCounter[1];
+				counter[2] = newCounter[2];
+				counter[3] = newCounter[3];
+				key[0] += 0x9E3779B9u;
+				key[1] += 0xBB67AE85u;
+			}
+			outValues[0] = counter[0];
+			outValues[1] = counter[1];
+			outValues[2] = counter[2];
+			outValues[3] = counter[3];
+		}
+
+	private:
+		uint32_t mKey[2];
+		uint64_t mStream;
+		uint64_t mBlockIndex = 0;
+		uint32_t mOutput[4] = {};
+		uint32_t mOutputIndex = 4;
+	};
+
+	// true if the generator can be split into independent substreams with split(index), e.g. Philox4x32
+	template<typename URNG, typename = void>
+	struct IsSplittable : std::false_type {};
+
+	template<typename URNG>
+	struct IsSplittable<URNG, std::void_t<decltype(std::declval<const URNG&>().split(uint64_t{}))>> : std::true_type {};
+
+	// returns 32 or 64 if the generator produces all the values of that many bits, otherwise returns 0
+	template<typename URNG>
+	constexpr int getRandomBitsCount()
+	{
+		using Generator = std::remove_reference_t<URNG>;
+		if constexpr (Generator::min() == 0 && Generator::max() == std::numeric_limits<uint32_t>::max())
+		{
+			return 32;
+		}
+		else if constexpr (Generator::min() == 0 && Generator::max() == std::numeric_limits<uint64_t>::max())
+		{
+			return 64;
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	// returns a uniformly distributed value in the open interval (0, 1), so it is always safe to take a logarithm of it
+	// for generators producing full 32 or 64-bit values the conversion is done without any divisions
+	template<typename RandType, typename URNG>
+	RandType generateUniform(URNG& rand)
+	{
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		constexpr int bitsCount = getRandomBitsCount<URNG>();
+
+		if constexpr (std::is_same_v<RandType, float> && bitsCount != 0)
+		{
+			// take 23 bits and put the value in the middle of its interval, this is exact in float
+			const uint32_t bits = static_cast<uint32_t>(static_cast<uint64_t>(rand()) >> (bitsCount - 23));
+			return (static_cast<float>(bits) + 0.5f) * (1.0f / 8388608.0f);
+		}
+		else if constexpr (std::is_same_v<RandType, double> && bitsCount != 0)
+		{
+			uint64_t bits = static_cast<uint64_t>(rand());
+			if constexpr (bitsCount == 32)
+			{
+				bits = (bits << 32) | static_cast<uint64_t>(rand());
+			}
+			return (static_cast<double>(bits >> 12) + 0.5) * (1.0 / 4503599627370496.0);
+		}
+		else
+		{
+			std::uniform_real_distribution<RandType> distribution{static_cast<RandType>(0.0), static_cast<RandType>(1.0)};
+			RandType result;
+			do
+			{
+				result = distribution(rand);
+			} while (result <= static_cast<RandType>(0.0) || result >= static_cast<RandType>(1.0));
+			return result;
+		}
+	}
+
+	// returns a uniformly distributed integer in the range [0, bound)
+	// uses Lemire's multiply-shift method (https://arxiv.org/abs/1805.10941) that avoids divisions in most of the cases
+	template<typename URNG>
+	size_t generateBounded(URNG& rand, size_t bound)
+	{
+		assert(bound > 0);
+		constexpr int bitsCount = getRandomBitsCount<URNG>();
+
+		if constexpr (bitsCount == 32)
+		{
+			if (bound <= std::numeric_limits<uint32_t>::max())
+			{
+				const uint32_t bound32 = static_cast<uint32_t>(bound);
+				uint64_t m = static_cast<uint64_t>(static_cast<uint32_t>(rand())) * bound32;
+				if (static_cast<uint32_t>(m) < bound32)
+				{
+					const uint32_t threshold = (0u - bound32) % bound32;
+					while (static_cast<uint32_t>(m) < threshold)
+					{
+						m = static_cast<uint64_t>(static_cast<uint32_t>(rand())) * bound32;
+					}
+				}
+				return static_cast<size_t>(m >> 32);
+			}
+		}
+#ifdef __SIZEOF_INT128__
+		else if constexpr (bitsCount == 64)
+		{
+			const uint64_t bound64 = static_cast<uint64_t>(bound);
+			unsigned __int128 m = static_cast<unsigned __int128>(static_cast<uint64_t>(rand())) * bound64;
+			if (static_cast<uint64_t>(m) < bound64)
+			{
+				const uint64_t threshold = (0u - bound64) % bound64;
+				while (static_cast<uint64_t>(m) < threshold)
+				{
+					m = static_cast<unsigned __int128>(static_cast<uint64_t>(rand())) * bound64;
+				}
+			}
+			return static_cast<size_t>(m >> 64);
+		}
+#endif
+
+		return std::uniform_int_distribution<size_t>(0, bound - 1)(rand);
+	}
+
+	// amount of elements to jump over for Algorithm L with the given W
+	// log1p keeps the precision when W is very small, which happens on long streams where 1 - W would be rounded to 1
+	// the result is clamped to not overflow size_t
+	template<typename RandType>
+	size_t getIndexesToJumpOver(RandType uniform, RandType weightJumpOver)
+	{
+		const RandType jump = std::floor(std::log(uniform) / std::log1p(-weightJumpOver));
+		constexpr RandType maxJump = static_cast<RandType>(std::numeric_limits<size_t>::max());
+		return jump < maxJump ? static_cast<size_t>(jump) : std::numeric_limits<size_t>::max();
+	}
+}
@@ -0,0 +1,285 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerScheduled implements Algorithm L the same way as ReservoirSampler, but with the jumps computed ahead of time
+// The lengths of the jumps and the replaced positions don't depend on the elements, so they are generated in batches
+// into a ring buffer, and considering an element takes only a pop from the buffer and the replacement of the element
+// Call refillSchedule outside of the latency sensitive code to keep the buffer filled,
+// if the buffer runs out, the next jump is generated in place the same way as in ReservoirSampler
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+template<typename T, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerScheduled : private StatsPolicy
+{
+public:
+	// C++17 doesn't support std::span, so we can do this instead
+	struct ResultSpan
+	{
+		ResultSpan(T* data, size_t size)
+			: data(data)
+			, size(size)
+		{}
+
+		T* data;
+		size_t size;
+
+		T* begin() { return data; }
+		const T* begin() const { return data; }
+		T* end() { return data + size; }
+		const T* end() const { return data + size; }
+	};
+
+public:
+	// scheduleSize is the amount of jumps that are generated ahead, the buffer is filled on construction
+	template<typename URNG_T = URNG>
+	ReservoirSamplerScheduled(size_t samplesCount, size_t scheduleSize, URNG_T&& rand = URNG{std::random_device{}()})
+		: mSamplesCount(samplesCount)
+		, mRand(std::forward<URNG_T>(rand))
+		, mSchedule(scheduleSize)
+	{
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		assert(samplesCount > 0);
+		assert(scheduleSize > 0);
+		mElements = std::allocator<T>().allocate(mSamplesCount);
+		this->onAllocation();
+		refillSchedule();
+	}
+
+	~ReservoirSamplerScheduled()
+	{
+		destroyElements();
+		std::allocator<T>().deallocate(mElements, mSamplesCount);
+	}
+
+	ReservoirSamplerScheduled(const ReservoirSamplerScheduled&) = delete;
+	ReservoirSamplerScheduled(ReservoirSamplerScheduled&&) = delete;
+	ReservoirSamplerScheduled& operator=(const ReservoirSamplerScheduled&) = delete;
+	ReservoirSamplerScheduled& operator=(ReservoirSamplerScheduled&&) = delete;
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(E&& element)
+	{
+		emplace<true>(std::move(element));
+	}
+
+	void sampleElement(const T& element)
+	{
+		emplace<true>(std::ref(element));
+	}
+
+	template<typename... Args>
+	void sampleElementEmplace(Args&&... arguments)
+	{
+		emplace<false>(std::forward<Args>(arguments)...);
+	}
+
+	ResultSpan getResult() const
+	{
+		return ResultSpan(mElements, mFilledElementsCount);
+	}
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result(std::make_move_iterator(mElements), std::make_move_iterator(mElements + mFilledElementsCount));
+		reset();
+		return result;
+	}
+
+	size_t getResultSize() const { return mFilledElementsCount; }
+
+	// fully resets the state and cleans all the stored data, allowing to be reused for a new sampling
+	// the scheduled jumps continue W of the previous sampling, so they are dropped,
+	// call refillSchedule before the next sampling to avoid generating the jumps in place
+	void reset()
+	{
+		destroyElements();
+		mIndexesToJumpOver = 0;
+		mScheduleLogWeight = {};
+		mScheduleBegin = 0;
+		mScheduledCount = 0;
+	}
+
+	// generates the jumps until the buffer is full, returns the amount of generated jumps
+	size_t refillSchedule()
+	{
+		const size_t scheduleSize = mSchedule.size();
+		const size_t generatedCount = scheduleSize - mScheduledCount;
+		for (size_t i = 0; i < generatedCount; ++i)
+		{
+			mSchedule[(mScheduleBegin + mScheduledCount) % scheduleSize] = generateJump();
+			++mScheduledCount;
+		}
+		return generatedCount;
+	}
+
+	// amount of jumps that can be taken before the buffer runs out
+	size_t getScheduledJumpsCount() const { return mScheduledCount; }
+
+	// optionally use this function in combination with skipNextElement in case creation of an object is expensive
+	// you can call skipNextElement every time this method returns false as in these cases the objects will be skipped
+	bool willNextElementBeConsidered() const
+	{
+		return mIndexesToJumpOver == 0;
+	}
+
+	// optionally use this in combination with willNextElementBeConsidered, refer to the comment above willNextElementBeConsidered
+	void skipNextElement()
+	{
+		assert(!willNextElementBeConsidered());
+		--mIndexesToJumpOver;
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+private:
+	struct Jump
+	{
+		// the position of the element that is replaced before the jump, not used for the first jump after filling the sampler
+		size_t replacedPosition;
+		size_t indexesToJumpOver;
+	};
+
+private:
+	void destroyElements()
+	{
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			mElements[i].~T();
+		}
+		mFilledElementsCount = 0;
+	}
+
+	template<bool isT, typename... Args>
+	void emplace(Args&&... arguments)
+	{
+		this->onElementsSeen(1);
+		if (mIndexesToJumpOver > 0)
+		{
+			--mIndexesToJumpOver;
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		if (mFilledElementsCount < mSamplesCount)
+		{
+			new (mElements + mFilledElementsCount) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			++mFilledElementsCount;
+
+			if (mFilledElementsCount == mSamplesCount)
+			{
+				mIndexesToJumpOver = popJump().indexesToJumpOver;
+			}
+		}
+		else
+		{
+			const Jump jump = popJump();
+			replaceElement<isT>(jump.replacedPosition, std::forward<Args>(arguments)...);
+			mIndexesToJumpOver = jump.indexesToJumpOver;
+		}
+	}
+
+	template<bool isT, typename... Args>
+	void replaceElement(size_t pos, Args&&... arguments)
+	{
+		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
+		{
+			mElements[pos] = std::forward<Args...>(arguments...);
+			this->onAssignment();
+		}
+		else if constexpr (std::is_move_assignable_v<T>)
+		{
+			mElements[pos] = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
+		}
+		else
+		{
+			mElements[pos].~T();
+			new (mElements + pos) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+		}
+	}
+
+	Jump popJump()
+	{
+		if (mScheduledCount == 0)
+		{
+			return generateJump();
+		}
+
+		const Jump jump = mSchedule[mScheduleBegin];
+		mScheduleBegin = (mScheduleBegin + 1) % mSchedule.size();
+		--mScheduledCount;
+		return jump;
+	}
+
+	// W is accumulated in log space, W_i = exp(log(u_1)/k + ... + log(u_i)/k)
+	Jump generateJump()
+	{
+		mScheduleLogWeight += std::log(generateUniform()) / static_cast<RandType>(mSamplesCount);
+		const RandType weightJumpOver = std::exp(mScheduleLogWeight);
+		const size_t indexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), weightJumpOver);
+		size_t replacedPosition = 0;
+		if (mSamplesCount > 1)
+		{
+			this->onRandomCall();
+			replacedPosition = ReservoirSamplerUtils::generateBounded(mRand, mSamplesCount);
+		}
+		return {replacedPosition, indexesToJumpOver};
+	}
+
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mRand);
+	}
+
+private:
+	const size_t mSamplesCount;
+	size_t mIndexesToJumpOver = 0;
+	size_t mFilledElementsCount = 0;
+	URNG mRand;
+	// ring buffer of the jumps generated ahead
+	std::vector<Jump> mSchedule;
+	size_t mScheduleBegin = 0;
+	size_t mScheduledCount = 0;
+	// log(W) after the last generated jump
+	RandType mScheduleLogWeight {};
+	T* mElements = nullptr;
+};
@@ -0,0 +1,246 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Helpers for serialize/deserialize methods of the samplers
+// The format uses the native byte order and type sizes, so the data should be read by a sampler of the same type built for the same platform
+namespace ReservoirSamplerUtils
+{
+	// appends binary data to a buffer
+	class BinaryWriter
+	{
+	public:
+		explicit BinaryWriter(std::vector<std::byte>& buffer)
+			: mBuffer(buffer)
+		{}
+
+		void writeBytes(const void* data, size_t size)
+		{
+			const size_t offset = mBuffer.size();
+			mBuffer.resize(offset + size);
+			if (size > 0)
+			{
+				std::memcpy(mBuffer.data() + offset, data, size);
+			}
+		}
+
+		template<typename V>
+		void write(const V& value)
+		{
+			static_assert(std::is_trivially_copyable_v<V>, "Only trivially copyable values can be written as bytes");
+			writeBytes(&value, sizeof(V));
+		}
+
+		// writes the data appended by serializeFunc(buffer) together with its size,
+		// so it can be read with BinaryReader::readNested, e.g. the state of a sampler that is a part of another sampler
+		template<typename SerializeFunc>
+		void writeNested(SerializeFunc&& serializeFunc)
+		{
+			const size_t sizeOffset = mBuffer.size();
+			write(size_t(0));
+			serializeFunc(mBuffer);
+			const size_t size = mBuffer.size() - sizeOffset - sizeof(size_t);
+			std::memcpy(mBuffer.data() + sizeOffset, &size, sizeof(size_t));
+		}
+
+	private:
+		std::vector<std::byte>& mBuffer;
+	};
+
+	// reads binary data from a buffer, every read returns false if there is not enough data left
+	class BinaryReader
+	{
+	public:
+		BinaryReader(const std::byte* data, size_t size)
+			: mData(data)
+			, mSize(size)
+		{}
+
+		bool readBytes(void* outData, size_t size)
+		{
+			if (mSize - mOffset < size)
+			{
+				return false;
+			}
+			if (size > 0)
+			{
+				std::memcpy(outData, mData + mOffset, size);
+			}
+			mOffset += size;
+			return true;
+		}
+
+		template<typename V>
+		bool read(V& outValue)
+		{
+			static_assert(std::is_trivially_copyable_v<V>, "Only trivially copyable values can be read as bytes");
+			return readBytes(&outValue, sizeof(V));
+		}
+
+		// passes the data written with BinaryWriter::writeNested to deserializeFunc(data, size), which returns false if it can't read it
+		template<typename DeserializeFunc>
+		bool readNested(DeserializeFunc&& deserializeFunc)
+		{
+			size_t size = 0;
+			if (!read(size) || getRemainingSize() < size)
+			{
+				return false;
+			}
+			const std::byte* data = mData + mOffset;
+			mOffset += size;
+			return deserializeFunc(data, size);
+		}
+
+		size_t getRemainingSize() const { return mSize - mOffset; }
+
+	private:
+		const std::byte* mData;
+		size_t mSize;
+		size_t mOffset = 0;
+	};
+
+	// the default element codec, copies the bytes of trivially copyable elements
+	// a custom codec should have the same two methods:
+	// void write(BinaryWriter& writer, const T& element) const
+	// std::optional<T> read(BinaryReader& reader) const
+	template<typename T>
+	struct TrivialCodec
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "The default codec supports only trivially copyable elements, provide a custom codec for other types");
+
+		void write(BinaryWriter& writer, const T& element) const
+		{
+			writer.write(element);
+		}
+
+		std::optional<T> read(BinaryReader& reader) const
+		{
+			T element;
+			if (!reader.read(element))
+			{
+				return std::nullopt;
+			}
+			return element;
+		}
+	};
+
+	enum class SerializedSamplerType : uint8_t
+	{
+		Uniform = 1,
+		UniformStatic = 2,
+		Weighted = 3,
+		WeightedStatic = 4,
+		Linear = 5,
+		Pool = 6,
+		Stratified = 7,
+		Windowed = 8,
+		Distinct = 9,
+		Sharded = 10,
+	};
+
+	constexpr uint8_t SerializationVersion = 1;
+
+	inline void writeHeader(BinaryWriter& writer, SerializedSamplerType type, size_t samplesCount)
+	{
+		writer.write(SerializationVersion);
+		writer.write(type);
+		writer.write(samplesCount);
+	}
+
+	inline bool readHeader(BinaryReader& reader, SerializedSamplerType type, size_t samplesCount)
+	{
+		uint8_t version = 0;
+		SerializedSamplerType readType {};
+		size_t readSamplesCount = 0;
+		return reader.read(version) && version == SerializationVersion
+			&& reader.read(readType) && readType == type
+			&& reader.read(readSamplesCount) && readSamplesCount == samplesCount;
+	}
+
+	// the state of the generator is copied as bytes, all the standard and the provided generators are trivially copyable
+	// for a reference URNG the state of the referenced generator is written and restored
+	template<typename URNG>
+	void writeRand(BinaryWriter& writer, const URNG& rand)
+	{
+		static_assert(std::is_trivially_copyable_v<std::remove_reference_t<URNG>>, "URNG should be trivially copyable to be serialized");
+		writer.write(rand);
+	}
+
+	template<typename URNG>
+	bool readRand(BinaryReader& reader, URNG& rand)
+	{
+		static_assert(std::is_trivially_copyable_v<std::remove_reference_t<URNG>>, "URNG should be trivially copyable to be serialized");
+		return reader.read(rand);
+	}
+
+	template<typename T, typename Codec>
+	void writeElements(BinaryWriter& writer, const T* elements, size_t count, const Codec& codec)
+	{
+		if constexpr (std::is_same_v<Codec, TrivialCodec<T>>)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable elements can be written as bytes");
+			writer.writeBytes(elements, sizeof(T)*count);
+		}
+		else
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				codec.write(writer, elements[i]);
+			}
+		}
+	}
+
+	// constructs the read elements in uninitialized outElements
+	// returns the amount of constructed elements, which is less than count if the data can't be read
+	template<typename T, typename Codec>
+	size_t readElements(BinaryReader& reader, T* outElements, size_t count, const Codec& codec)
+	{
+		if constexpr (std::is_same_v<Codec, TrivialCodec<T>>)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable elements can be read as bytes");
+			return reader.readBytes(outElements, sizeof(T)*count) ? count : 0;
+		}
+		else
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				std::optional<T> element = codec.read(reader);
+				if (!element)
+				{
+					return i;
+				}
+				new (outElements + i) T(std::move(*element));
+			}
+			return count;
+		}
+	}
+}
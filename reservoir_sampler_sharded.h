@@ -0,0 +1,318 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reservoir_sampler_serialization.h"
+
+// ReservoirSamplerSharded keeps a separate sampler per worker and merges them on request
+// It can wrap ReservoirSampler or ReservoirSamplerWeighted (any sampler that supports merge)
+// Every worker should use its own shard index, so nothing is shared between the workers on the hot path
+// The elements that fall into a jump gap are counted by the worker without any locks or atomic read-modify-writes,
+// only the considered elements lock the shard, and the lock is contended only while a snapshot is being made
+//
+// Important: reset should not be called concurrently with sampling
+template<typename Sampler>
+class ReservoirSamplerSharded
+{
+public:
+	// creates shardsCount samplers with samplesCount samples and the default random generators
+	ReservoirSamplerSharded(size_t shardsCount, size_t samplesCount)
+		: ReservoirSamplerSharded(shardsCount, [samplesCount](size_t) { return Sampler(samplesCount); })
+	{
+	}
+
+	// creates shardsCount samplers by calling factory(shardIndex) for each of them
+	// one more sampler is created with factory(shardsCount) to merge the snapshots with its own random generator
+	// the samplers should use differently seeded random generators
+	template<typename Factory, typename = std::enable_if_t<std::is_invocable_r_v<Sampler, Factory, size_t>>>
+	ReservoirSamplerSharded(size_t shardsCount, Factory&& factory)
+		: mMergeSampler(factory(shardsCount))
+	{
+		assert(shardsCount > 0);
+		mShards.reserve(shardsCount);
+		for (size_t i = 0; i < shardsCount; ++i)
+		{
+			mShards.push_back(std::make_unique<Shard>(factory(i)));
+			updateGap(*mShards.back());
+		}
+	}
+
+	template<typename... Args>
+	void sampleElement(size_t shardIndex, Args&&... arguments)
+	{
+		Shard& shard = getShard(shardIndex);
+		if (skipIfInGap(shard, arguments...))
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		applySkipped(shard, shard.sampler);
+		shard.sampler.sampleElement(std::forward<Args>(arguments)...);
+		updateGap(shard);
+	}
+
+	template<typename... Args>
+	void sampleElementEmplace(size_t shardIndex, Args&&... arguments)
+	{
+		Shard& shard = getShard(shardIndex);
+		if (skipIfInGap(shard, arguments...))
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		applySkipped(shard, shard.sampler);
+		shard.sampler.sampleElementEmplace(std::forward<Args>(arguments)...);
+		updateGap(shard);
+	}
+
+	// returns a sampler with the merged state of all the shards
+	// each shard is locked only for the time of copying it, the workers keep skipping elements meanwhile
+	Sampler getSnapshot() const
+	{
+		std::lock_guard<std::mutex> lock(mMergeMutex);
+		for (size_t i = 0; i < mShards.size(); ++i)
+		{
+			mMergeSampler.merge(copyShard(i));
+		}
+		Sampler result(mMergeSampler);
+		// keeps the advanced random generator for the next snapshot
+		mMergeSampler.reset();
+		return result;
+	}
+
+	auto getResult() const
+	{
+		return getSnapshot().consumeResult();
+	}
+
+	size_t getShardsCount() const { return mShards.size(); }
+
+	// the stats of all the shards together (Sampler's StatsPolicy should support merge)
+	// the elements skipped by a shard after its last considered element are counted with its next considered element
+	auto getStats() const
+	{
+		auto result = getShardStats(0);
+		for (size_t i = 1; i < mShards.size(); ++i)
+		{
+			result.merge(getShardStats(i));
+		}
+		return result;
+	}
+
+	// fully resets the state of all the shards, allowing to be reused for a new sampling
+	void reset()
+	{
+		for (const std::unique_ptr<Shard>& shard : mShards)
+		{
+			std::lock_guard<std::mutex> lock(shard->mutex);
+			shard->sampler.reset();
+			updateGap(*shard);
+		}
+	}
+
+	// writes the state of the merging sampler and of every shard to the end of buffer with serialize of Sampler,
+	// the codec (if any) is passed to it, each shard is copied under its lock the same way as for getSnapshot
+	template<typename... Codec>
+	void serialize(std::vector<std::byte>& buffer, const Codec&... codec) const
+	{
+		std::lock_guard<std::mutex> lock(mMergeMutex);
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Sharded, mShards.size());
+		writer.writeNested([this, &codec...](std::vector<std::byte>& samplerBuffer) { mMergeSampler.serialize(samplerBuffer, codec...); });
+		for (size_t i = 0; i < mShards.size(); ++i)
+		{
+			const Sampler shardSampler = copyShard(i);
+			writer.writeNested([&shardSampler, &codec...](std::vector<std::byte>& samplerBuffer) { shardSampler.serialize(samplerBuffer, codec...); });
+		}
+	}
+
+	// restores the state written by serialize, the sampler should have the same shards count and the same samplers
+	// returns false if the data can't be read, in this case all the shards are left in the reset state
+	// should not be called concurrently with sampling, the same as reset
+	template<typename... Codec>
+	bool deserialize(const std::byte* data, size_t size, const Codec&... codec)
+	{
+		std::lock_guard<std::mutex> lock(mMergeMutex);
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		bool isRead = ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Sharded, mShards.size())
+			&& reader.readNested([this, &codec...](const std::byte* samplerData, size_t samplerSize) { return mMergeSampler.deserialize(samplerData, samplerSize, codec...); });
+		for (const std::unique_ptr<Shard>& shard : mShards)
+		{
+			std::lock_guard<std::mutex> shardLock(shard->mutex);
+			isRead = isRead && reader.readNested([&shard, &codec...](const std::byte* samplerData, size_t samplerSize) { return shard->sampler.deserialize(samplerData, samplerSize, codec...); });
+			updateGap(*shard);
+		}
+
+		if (!isRead)
+		{
+			reset();
+			mMergeSampler.reset();
+		}
+		return isRead;
+	}
+
+private:
+	template<typename S, typename = void>
+	struct IsWeighted : std::false_type {};
+
+	template<typename S>
+	struct IsWeighted<S, std::void_t<decltype(std::declval<const S&>().getWeightToJumpOver())>> : std::true_type {};
+
+	template<typename S, bool Weighted = IsWeighted<S>::value>
+	struct GapTraits
+	{
+		// the amount of elements left in the jump
+		using Type = size_t;
+	};
+
+	template<typename S>
+	struct GapTraits<S, true>
+	{
+		// the weight left in the jump
+		using Type = std::decay_t<decltype(std::declval<const S&>().getWeightToJumpOver())>;
+	};
+
+	using GapType = typename GapTraits<Sampler>::Type;
+
+	// aligned to the cache line size to avoid false sharing between the workers
+	struct alignas(64) Shard
+	{
+		explicit Shard(Sampler&& sampler)
+			: sampler(std::move(sampler))
+		{}
+
+		mutable std::mutex mutex;
+		Sampler sampler;
+		// the jump of the sampler as of the last considered element, changed only under the lock
+		GapType gap{};
+		// the elements skipped since the last considered element, written only by the owning worker
+		// and read by the snapshots to bring their copy of the sampler up to date
+		std::atomic<size_t> skippedCount{0};
+		std::atomic<GapType> gapLeft{};
+	};
+
+private:
+	Shard& getShard(size_t shardIndex)
+	{
+		assert(shardIndex < mShards.size());
+		return *mShards[shardIndex];
+	}
+
+	template<typename... Args>
+	static bool skipIfInGap(Shard& shard, const Args&... arguments)
+	{
+		const size_t skippedCount = shard.skippedCount.load(std::memory_order_relaxed);
+		if constexpr (IsWeighted<Sampler>::value)
+		{
+			// the same check as in willNextElementBeConsidered of the weighted sampler
+			const GapType gapLeft = shard.gapLeft.load(std::memory_order_relaxed);
+			const GapType newGapLeft = gapLeft - getFirst(arguments...);
+			if (newGapLeft <= 0)
+			{
+				return false;
+			}
+			shard.gapLeft.store(newGapLeft, std::memory_order_relaxed);
+		}
+		else
+		{
+			if (skippedCount >= shard.gap)
+			{
+				return false;
+			}
+		}
+		shard.skippedCount.store(skippedCount + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	template<typename First, typename... Rest>
+	static const First& getFirst(const First& first, const Rest&...)
+	{
+		return first;
+	}
+
+	// should be called with the shard locked
+	static void applySkipped(const Shard& shard, Sampler& sampler)
+	{
+		const size_t skippedCount = shard.skippedCount.load(std::memory_order_relaxed);
+		if (skippedCount == 0)
+		{
+			return;
+		}
+
+		if constexpr (IsWeighted<Sampler>::value)
+		{
+			sampler.jumpAhead(skippedCount, shard.gap - shard.gapLeft.load(std::memory_order_relaxed));
+		}
+		else
+		{
+			sampler.jumpAhead(skippedCount);
+		}
+	}
+
+	// should be called with the shard locked
+	static void updateGap(Shard& shard)
+	{
+		if constexpr (IsWeighted<Sampler>::value)
+		{
+			shard.gap = shard.sampler.getWeightToJumpOver();
+			shard.gapLeft.store(shard.gap, std::memory_order_relaxed);
+		}
+		else
+		{
+			shard.gap = shard.sampler.getNextSkippedElementsCount();
+		}
+		shard.skippedCount.store(0, std::memory_order_relaxed);
+	}
+
+	auto getShardStats(size_t shardIndex) const
+	{
+		const Shard& shard = *mShards[shardIndex];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		return std::decay_t<decltype(shard.sampler.getStats())>(shard.sampler.getStats());
+	}
+
+	Sampler copyShard(size_t shardIndex) const
+	{
+		const Shard& shard = *mShards[shardIndex];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		Sampler result = shard.sampler;
+		applySkipped(shard, result);
+		return result;
+	}
+
+private:
+	std::vector<std::unique_ptr<Shard>> mShards;
+	mutable std::mutex mMergeMutex;
+	mutable Sampler mMergeSampler;
+};
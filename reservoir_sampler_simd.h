@@ -0,0 +1,177 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define RESERVOIR_SAMPLER_SIMD_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RESERVOIR_SAMPLER_SIMD_NEON
+#endif
+
+namespace ReservoirSamplerUtils
+{
+	// sum of 8 float weights, negative weights are counted as zero
+	inline float sumWeightsBlock8(const float* weights)
+	{
+#if defined(RESERVOIR_SAMPLER_SIMD_X86) && defined(__AVX__)
+		const __m256 block = _mm256_max_ps(_mm256_loadu_ps(weights), _mm256_setzero_ps());
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(block), _mm256_extractf128_ps(block, 1));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+#elif defined(RESERVOIR_SAMPLER_SIMD_X86)
+		const __m128 low = _mm_max_ps(_mm_loadu_ps(weights), _mm_setzero_ps());
+		const __m128 high = _mm_max_ps(_mm_loadu_ps(weights + 4), _mm_setzero_ps());
+		__m128 sum = _mm_add_ps(low, high);
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+		return _mm_cvtss_f32(sum);
+#elif defined(RESERVOIR_SAMPLER_SIMD_NEON)
+		const float32x4_t low = vmaxq_f32(vld1q_f32(weights), vdupq_n_f32(0.0f));
+		const float32x4_t high = vmaxq_f32(vld1q_f32(weights + 4), vdupq_n_f32(0.0f));
+		return vaddvq_f32(vaddq_f32(low, high));
+#else
+		float sum = 0.0f;
+		for (size_t i = 0; i < 8; ++i)
+		{
+			sum += std::max(weights[i], 0.0f);
+		}
+		return sum;
+#endif
+	}
+
+	// sum of 8 double weights, negative weights are counted as zero
+	inline double sumWeightsBlock8(const double* weights)
+	{
+#if defined(RESERVOIR_SAMPLER_SIMD_X86) && defined(__AVX__)
+		const __m256d low = _mm256_max_pd(_mm256_loadu_pd(weights), _mm256_setzero_pd());
+		const __m256d high = _mm256_max_pd(_mm256_loadu_pd(weights + 4), _mm256_setzero_pd());
+		const __m256d block = _mm256_add_pd(low, high);
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(block), _mm256_extractf128_pd(block, 1));
+		sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+		return _mm_cvtsd_f64(sum);
+#elif defined(RESERVOIR_SAMPLER_SIMD_X86)
+		__m128d sum = _mm_max_pd(_mm_loadu_pd(weights), _mm_setzero_pd());
+		for (size_t i = 2; i < 8; i += 2)
+		{
+			sum = _mm_add_pd(sum, _mm_max_pd(_mm_loadu_pd(weights + i), _mm_setzero_pd()));
+		}
+		sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+		return _mm_cvtsd_f64(sum);
+#elif defined(RESERVOIR_SAMPLER_SIMD_NEON)
+		float64x2_t sum = vmaxq_f64(vld1q_f64(weights), vdupq_n_f64(0.0));
+		for (size_t i = 2; i < 8; i += 2)
+		{
+			sum = vaddq_f64(sum, vmaxq_f64(vld1q_f64(weights + i), vdupq_n_f64(0.0)));
+		}
+		return vaddvq_f64(sum);
+#else
+		double sum = 0.0;
+		for (size_t i = 0; i < 8; ++i)
+		{
+			sum += std::max(weights[i], 0.0);
+		}
+		return sum;
+#endif
+	}
+
+	constexpr size_t WeightsBlockSize = 8;
+
+	// skips the whole blocks of weights that end before the jump does, subtracting their sums from weightJumpOver
+	// returns the amount of skipped weights, the weights after them should be checked one by one
+	// only float and double weights are summed in blocks, negative weights are counted as zero
+	template<typename WeightType, typename SumType>
+	size_t skipWeightsBlocks(const WeightType* weights, size_t count, SumType& weightJumpOver)
+	{
+		size_t i = 0;
+		if constexpr (std::is_same_v<WeightType, float> || std::is_same_v<WeightType, double>)
+		{
+			for (; i + WeightsBlockSize <= count; i += WeightsBlockSize)
+			{
+				const SumType weightLeft = weightJumpOver - static_cast<SumType>(sumWeightsBlock8(weights + i));
+				if (weightLeft <= SumType{})
+				{
+					break;
+				}
+				weightJumpOver = weightLeft;
+			}
+		}
+		return i;
+	}
+
+	// the batch sampling of the weighted samplers, the sampler is accessed through the callbacks:
+	// isFilling() returns true while the sampler is not filled, considerElement(index) samples the element with that index
+	// and skipElements(count) counts the skipped elements, weightJumpOver is the remaining weight of the sampler's jump
+	// the end of a jump is found with the same subtraction as the samplers do for one element, so they agree on the element to consider
+	template<typename WeightType, typename RandType, typename IsFillingFunc, typename ConsiderFunc, typename SkipFunc>
+	void sampleWeightsBatch(const WeightType* weights, size_t count, RandType& weightJumpOver, IsFillingFunc&& isFilling, ConsiderFunc&& considerElement, SkipFunc&& skipElements)
+	{
+		size_t i = 0;
+		while (i < count)
+		{
+			if (isFilling())
+			{
+				if (static_cast<RandType>(weights[i]) > static_cast<RandType>(0.0))
+				{
+					considerElement(i);
+				}
+				else
+				{
+					skipElements(size_t(1));
+				}
+				++i;
+				continue;
+			}
+
+			const size_t blocksEnd = i + skipWeightsBlocks(weights + i, count - i, weightJumpOver);
+			const size_t walkEnd = std::min(count, blocksEnd + WeightsBlockSize);
+			size_t crossingIndex = blocksEnd;
+			for (; crossingIndex < walkEnd; ++crossingIndex)
+			{
+				const RandType weight = static_cast<RandType>(weights[crossingIndex]);
+				if (weight > static_cast<RandType>(0.0))
+				{
+					if (weightJumpOver - weight <= static_cast<RandType>(0.0))
+					{
+						break;
+					}
+					weightJumpOver -= weight;
+				}
+			}
+			skipElements(crossingIndex - i);
+
+			i = crossingIndex;
+			if (crossingIndex < walkEnd)
+			{
+				considerElement(crossingIndex);
+				++i;
+			}
+		}
+	}
+}
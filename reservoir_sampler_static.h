@@ -24,17 +24,26 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <functional>
+#include <iterator>
 #include <random>
 #include <type_traits>
 #include <vector>
 
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_stats.h"
+
 // ReservoirSamplerStatic implements Algorithm L for reservoir sampling
 // https://en.wikipedia.org/wiki/Reservoir_sampling#Optimal:_Algorithm_L
 // Objects of the class don't allocate memory on heap (unless stored types allocate data themselves)
-template<typename T, size_t SamplesCount, typename URNG = std::mt19937, typename RandType = float>
-class ReservoirSamplerStatic
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+template<typename T, size_t SamplesCount, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerStatic : private StatsPolicy
 {
 public:
 	// C++17 doesn't support std::span, so we can do this instead
@@ -55,8 +64,8 @@ public:
 	};
 
 public:
-	template<typename URNG_T = URNG, typename = std::enable_if_t<!std::is_same_v<std::decay_t<URNG_T>, ReservoirSamplerStatic<T, SamplesCount, URNG, RandType>>>>
-	explicit ReservoirSamplerStatic(URNG_T&& rand = std::mt19937{std::random_device{}()})
+	template<typename URNG_T = URNG, typename = std::enable_if_t<!std::is_same_v<std::decay_t<URNG_T>, ReservoirSamplerStatic<T, SamplesCount, URNG, RandType, StatsPolicy>>>>
+	explicit ReservoirSamplerStatic(URNG_T&& rand = URNG{std::random_device{}()})
 		: mRand(std::forward<URNG_T>(rand))
 	{
 		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
@@ -69,57 +78,47 @@ public:
 	}
 
 	ReservoirSamplerStatic(const ReservoirSamplerStatic& other)
-		: mIndexesToJumpOver(other.mIndexesToJumpOver)
+		: StatsPolicy(other)
+		, mIndexesToJumpOver(other.mIndexesToJumpOver)
 		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
 	{
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(other.mElements[i]);
-		}
+		copyElementsFrom(other);
 	}
 
 	ReservoirSamplerStatic(ReservoirSamplerStatic&& other) noexcept
-		: mIndexesToJumpOver(other.mIndexesToJumpOver)
+		: StatsPolicy(other)
+		, mIndexesToJumpOver(other.mIndexesToJumpOver)
 		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
 	{
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(std::move(other.mElements[i]));
-		}
+		moveElementsFrom(other);
 		other.reset();
 	}
 
 	ReservoirSamplerStatic& operator=(const ReservoirSamplerStatic& other)
 	{
 		reset();
+		StatsPolicy::operator=(other);
 		mIndexesToJumpOver = other.mIndexesToJumpOver;
 		mWeightJumpOver = other.mWeightJumpOver;
 		mFilledElementsCount = other.mFilledElementsCount;
 
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(other.mElements[i]);
-		}
+		copyElementsFrom(other);
 		return *this;
 	}
 
 	ReservoirSamplerStatic& operator=(ReservoirSamplerStatic&& other) noexcept
 	{
 		reset();
+		StatsPolicy::operator=(other);
 		mIndexesToJumpOver = other.mIndexesToJumpOver;
 		mWeightJumpOver = other.mWeightJumpOver;
 		mFilledElementsCount = other.mFilledElementsCount;
 
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(std::move(other.mElements[i]));
-		}
+		moveElementsFrom(other);
 		other.reset();
 		return *this;
 	}
@@ -141,6 +140,73 @@ public:
 		emplace<false>(std::forward<Args>(arguments)...);
 	}
 
+	// samples all the elements of the range, the elements that are not going to be considered are not accessed
+	// with random access iterators the skipped elements are jumped over in constant time
+	template<typename It>
+	void sampleRange(It first, It last)
+	{
+		sampleRange(first, last, [](auto&& element) -> decltype(auto) { return std::forward<decltype(element)>(element); });
+	}
+
+	// same as above, but the stored elements are produced by projection (e.g. a pointer to member)
+	// the projection is called only for the elements that are going to be considered
+	template<typename It, typename Projection>
+	void sampleRange(It first, It last, Projection&& projection)
+	{
+		if constexpr (!std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<It>::iterator_category>)
+		{
+			// single-pass iterators can't be measured in advance, so they are walked one element at a time
+			for (; first != last; ++first)
+			{
+				if (willNextElementBeConsidered())
+				{
+					emplace<true>(std::invoke(projection, *first));
+				}
+				else
+				{
+					skipNextElement();
+				}
+			}
+		}
+		else
+		{
+			size_t elementsLeft = static_cast<size_t>(std::distance(first, last));
+
+			// the fill phase doesn't need any checks, the last element of it goes through emplace to set up the first jump
+			while (mFilledElementsCount + 1 < SamplesCount && elementsLeft > 0)
+			{
+				this->onElementsSeen(1);
+				insertInitial(std::invoke(projection, *first));
+				++first;
+				--elementsLeft;
+			}
+
+			while (elementsLeft > 0)
+			{
+				if (mIndexesToJumpOver == 0)
+				{
+					emplace<true>(std::invoke(projection, *first));
+					++first;
+					--elementsLeft;
+				}
+				else
+				{
+					const size_t skipAmount = std::min(mIndexesToJumpOver, elementsLeft);
+					std::advance(first, static_cast<typename std::iterator_traits<It>::difference_type>(skipAmount));
+					elementsLeft -= skipAmount;
+					mIndexesToJumpOver -= skipAmount;
+					this->onElementsSeen(skipAmount);
+					this->onElementsSkipped(skipAmount);
+				}
+			}
+		}
+	}
+
+	void sampleBatch(const T* elements, size_t count)
+	{
+		sampleRange(elements, elements + count);
+	}
+
 	ResultSpan getResult() const
 	{
 		return ResultSpan(mElements, mFilledElementsCount);
@@ -148,9 +214,7 @@ public:
 
 	std::vector<T> consumeResult()
 	{
-		std::vector<T> result;
-		result.reserve(mFilledElementsCount);
-		std::move(mElements, mElements + mFilledElementsCount, std::back_inserter(result));
+		std::vector<T> result(std::make_move_iterator(mElements), std::make_move_iterator(mElements + mFilledElementsCount));
 
 		reset();
 
@@ -190,6 +254,8 @@ public:
 	{
 		assert(!willNextElementBeConsidered());
 		--mIndexesToJumpOver;
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
 	}
 
 	// optionally use in case in combination with jumpAhead to skip elements that are not going to be considered
@@ -205,35 +271,126 @@ public:
 	{
 		assert(elementsToJumpOver <= mIndexesToJumpOver);
 		mIndexesToJumpOver -= elementsToJumpOver;
+		this->onElementsSeen(elementsToJumpOver);
+		this->onElementsSkipped(elementsToJumpOver);
+	}
+
+	// writes the full state of the sampler including the state of the random generator and the elements to the end of buffer
+	// Codec defines how the elements are written, the default one copies the bytes of trivially copyable types
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::UniformStatic, SamplesCount);
+		writer.write(mIndexesToJumpOver);
+		writer.write(mWeightJumpOver);
+		ReservoirSamplerUtils::writeRand(writer, mRand);
+		writer.write(mFilledElementsCount);
+		ReservoirSamplerUtils::writeElements(writer, mElements, mFilledElementsCount, codec);
+	}
+
+	// restores the state written by serialize, the sampler should have the same samples count
+	// returns false if the data can't be read, in this case the sampler is left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		size_t indexesToJumpOver = 0;
+		RandType weightJumpOver {};
+		size_t filledElementsCount = 0;
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::UniformStatic, SamplesCount)
+			|| !reader.read(indexesToJumpOver)
+			|| !reader.read(weightJumpOver)
+			|| !ReservoirSamplerUtils::readRand(reader, mRand)
+			|| !reader.read(filledElementsCount)
+			|| filledElementsCount > SamplesCount)
+		{
+			return false;
+		}
+
+		mFilledElementsCount = ReservoirSamplerUtils::readElements(reader, mElements, filledElementsCount, codec);
+		if (mFilledElementsCount != filledElementsCount)
+		{
+			reset();
+			return false;
+		}
+
+		mIndexesToJumpOver = indexesToJumpOver;
+		mWeightJumpOver = weightJumpOver;
+		return true;
 	}
 
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
 private:
+	// trivially copyable elements are copied as one block, but still counted as constructed in the stats
+	void copyElementsFrom(const ReservoirSamplerStatic& other)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			std::memcpy(mElements, other.mElements, sizeof(T)*other.mFilledElementsCount);
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				this->onConstruction();
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				new (mElements + i) T(other.mElements[i]);
+				this->onConstruction();
+			}
+		}
+	}
+
+	void moveElementsFrom(ReservoirSamplerStatic& other)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			copyElementsFrom(other);
+		}
+		else
+		{
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				new (mElements + i) T(std::move(other.mElements[i]));
+				this->onConstruction();
+			}
+		}
+	}
+
 	template<bool isT, typename... Args>
 	void emplace(Args&&... arguments)
 	{
-		if (mFilledElementsCount < SamplesCount)
+		this->onElementsSeen(1);
+
+		// the jump is zero during the fill phase, so the most common case is checked first
+		if (mIndexesToJumpOver > 0)
+		{
+			--mIndexesToJumpOver;
+			this->onElementsSkipped(1);
+		}
+		else if (mFilledElementsCount < SamplesCount)
 		{
 			insertInitial(std::forward<Args>(arguments)...);
 
 			if (mFilledElementsCount == SamplesCount)
 			{
-				mWeightJumpOver = std::exp(std::log(mUniformDist(mRand)) / SamplesCount);
-				mIndexesToJumpOver = static_cast<size_t>(std::floor(std::log(mUniformDist(mRand))/std::log(static_cast<RandType>(1.0) - mWeightJumpOver)));
+				mWeightJumpOver = generateWeightFactor();
+				mIndexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), mWeightJumpOver);
 			}
 		}
 		else
 		{
-			if (mIndexesToJumpOver == 0)
-			{
-				replaceElement<isT>(std::forward<Args>(arguments)...);
+			replaceElement<isT>(std::forward<Args>(arguments)...);
 
-				mWeightJumpOver *= std::exp(std::log(mUniformDist(mRand)) / SamplesCount);
-				mIndexesToJumpOver += static_cast<size_t>(std::floor(std::log(mUniformDist(mRand))/std::log(static_cast<RandType>(1.0) - mWeightJumpOver)));
-			}
-			else
-			{
-				--mIndexesToJumpOver;
-			}
+			mWeightJumpOver *= generateWeightFactor();
+			mIndexesToJumpOver = ReservoirSamplerUtils::getIndexesToJumpOver(generateUniform(), mWeightJumpOver);
 		}
 	}
 
@@ -241,33 +398,101 @@ private:
 	void insertInitial(Args&&... arguments)
 	{
 		new (mElements + mFilledElementsCount) T(std::forward<Args>(arguments)...);
+		this->onConstruction();
 		++mFilledElementsCount;
 	}
 
 	template<bool isT, typename... Args>
 	void replaceElement(Args&&... arguments)
 	{
-		const size_t pos = SamplesCount > 1 ? (mRand() % SamplesCount) : 0;
+		const size_t pos = generateReplacedIndex();
 		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
 		{
 			mElements[pos] = std::forward<Args...>(arguments...);
+			this->onAssignment();
 		}
 		else if constexpr (std::is_move_assignable_v<T>)
 		{
 			mElements[pos] = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
 		}
 		else
 		{
 			mElements[pos].~T();
 			new (mElements + pos) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+		}
+	}
+
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mRand);
+	}
+
+	size_t generateBounded(size_t bound)
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateBounded(mRand, bound);
+	}
+
+	// u^(1/k) to update W, small samples counts don't need exp and log
+	RandType generateWeightFactor()
+	{
+		if constexpr (SamplesCount == 1)
+		{
+			return generateUniform();
+		}
+		else if constexpr (SamplesCount == 2)
+		{
+			return std::sqrt(generateUniform());
+		}
+		else if constexpr (SamplesCount == 4)
+		{
+			return std::sqrt(std::sqrt(generateUniform()));
+		}
+		else
+		{
+			constexpr RandType invertedSamplesCount = static_cast<RandType>(1.0) / static_cast<RandType>(SamplesCount);
+			return std::exp(std::log(generateUniform()) * invertedSamplesCount);
+		}
+	}
+
+	size_t generateReplacedIndex()
+	{
+		constexpr int randomBitsCount = ReservoirSamplerUtils::getRandomBitsCount<URNG>();
+		if constexpr (SamplesCount == 1)
+		{
+			return 0;
+		}
+		else if constexpr ((SamplesCount & (SamplesCount - 1)) == 0 && getBitsCount(SamplesCount - 1) < randomBitsCount)
+		{
+			// for a power of two the top bits of the random value are already uniformly distributed
+			constexpr int shift = randomBitsCount - getBitsCount(SamplesCount - 1);
+			this->onRandomCall();
+			return static_cast<size_t>(static_cast<uint64_t>(mRand()) >> shift);
+		}
+		else
+		{
+			return generateBounded(SamplesCount);
 		}
 	}
 
+	static constexpr int getBitsCount(size_t value)
+	{
+		int result = 0;
+		for (; value > 0; value >>= 1)
+		{
+			++result;
+		}
+		return result;
+	}
+
 private:
 	size_t mIndexesToJumpOver = 0;
 	RandType mWeightJumpOver {};
 	URNG mRand;
-	std::uniform_real_distribution<RandType> mUniformDist{static_cast<RandType>(0.0), static_cast<RandType>(1.0)};
 	size_t mFilledElementsCount = 0;
 	T* const mElements = reinterpret_cast<T*>(mData);
 	alignas(T) std::byte mData[sizeof(T)*SamplesCount];
@@ -0,0 +1,82 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+
+// Stats policies that can be provided to the samplers as StatsPolicy template parameter
+// The samplers inherit from the policy, so an empty policy doesn't add anything to the size
+// merge is needed only by getStats of the samplers that are made of several samplers (ReservoirSamplerWindowed, ReservoirSamplerSharded)
+
+// the default policy, doesn't collect anything and all the calls are optimized out
+struct ReservoirSamplerNoStats
+{
+	void onElementsSeen(size_t) {}
+	void onElementsSkipped(size_t) {}
+	void onRandomCall() {}
+	void onConstruction() {}
+	void onAssignment() {}
+	void onHeapOperation() {}
+	void onAllocation() {}
+	void merge(const ReservoirSamplerNoStats&) {}
+};
+
+// collects the counters that can be accessed with getStats() of the sampler
+// the counters are not cleared by reset() of the sampler
+struct ReservoirSamplerStats
+{
+	// all the elements that went through the sampler
+	size_t elementsSeenCount = 0;
+	// elements that were rejected without being considered (e.g. skipped by a jump)
+	size_t elementsSkippedCount = 0;
+	// random values generated
+	size_t randomCallsCount = 0;
+	// constructions of the stored elements
+	size_t constructionsCount = 0;
+	// assignments to the stored elements
+	size_t assignmentsCount = 0;
+	// push and pop operations on the priority heap of the weighted samplers
+	size_t heapOperationsCount = 0;
+	// memory allocations made by the sampler
+	size_t allocationsCount = 0;
+
+	void onElementsSeen(size_t count) { elementsSeenCount += count; }
+	void onElementsSkipped(size_t count) { elementsSkippedCount += count; }
+	void onRandomCall() { ++randomCallsCount; }
+	void onConstruction() { ++constructionsCount; }
+	void onAssignment() { ++assignmentsCount; }
+	void onHeapOperation() { ++heapOperationsCount; }
+	void onAllocation() { ++allocationsCount; }
+
+	// adds the counters of another sampler, used by the samplers that are made of several samplers
+	void merge(const ReservoirSamplerStats& other)
+	{
+		elementsSeenCount += other.elementsSeenCount;
+		elementsSkippedCount += other.elementsSkippedCount;
+		randomCallsCount += other.randomCallsCount;
+		constructionsCount += other.constructionsCount;
+		assignmentsCount += other.assignmentsCount;
+		heapOperationsCount += other.heapOperationsCount;
+		allocationsCount += other.allocationsCount;
+	}
+};
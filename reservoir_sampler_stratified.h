@@ -0,0 +1,320 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "reservoir_sampler_heap.h"
+#include "reservoir_sampler_pool.h"
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerStratified samples many strata of one stream at once, every stratum has its own samples count
+// A stratum can be sampled uniformly with Algorithm L (sampleElement) or with weights with Algorithm A-ExpJ (sampleWeightedElement)
+// The storage, the uniform sampling and the per-stratum accessors come from ReservoirSamplerPool (a stratum is a group of it),
+// the priority heap is allocated only for the strata that are sampled with weights
+// StatsPolicy allows to collect stats about the sampling of all the strata together, see reservoir_sampler_stats.h
+//
+// Important: a stratum should be sampled either only with weights or only without them until it is reset
+template<typename T, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerStratified : public ReservoirSamplerPool<T, URNG, RandType, StatsPolicy>
+{
+	using Pool = ReservoirSamplerPool<T, URNG, RandType, StatsPolicy>;
+
+public:
+	// samplesCounts contains the samples count for every stratum
+	template<typename URNG_T = URNG>
+	explicit ReservoirSamplerStratified(const std::vector<size_t>& samplesCounts, URNG_T&& rand = URNG{std::random_device{}()})
+		: Pool(samplesCounts, std::forward<URNG_T>(rand))
+		, mHeapOffsets(samplesCounts.size(), NoHeap)
+	{
+		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
+	}
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleWeightedElement(size_t stratum, WeightType weight, E&& element)
+	{
+		emplaceWeighted<true>(stratum, weight, std::move(element));
+	}
+
+	void sampleWeightedElement(size_t stratum, WeightType weight, const T& element)
+	{
+		emplaceWeighted<true>(stratum, weight, std::ref(element));
+	}
+
+	template<typename... Args>
+	void sampleWeightedElementEmplace(size_t stratum, WeightType weight, Args&&... arguments)
+	{
+		emplaceWeighted<false>(stratum, weight, std::forward<Args>(arguments)...);
+	}
+
+	// samples count elements where strata[i] is the stratum of elements[i]
+	// the elements are grouped by stratum first (keeping their order inside of every stratum),
+	// so the state of one stratum is accessed for all its elements in a row and the skipped elements are jumped over
+	void sampleBatch(const size_t* strata, const T* elements, size_t count)
+	{
+		groupByStratum(strata, count);
+
+		for (size_t stratum = 0; stratum < this->mGroupsCount; ++stratum)
+		{
+			size_t i = mBatchStrataBegins[stratum];
+			const size_t end = mBatchStrataBegins[stratum + 1];
+			while (i < end)
+			{
+				const size_t skipAmount = std::min(this->mIndexesToJumpOver[stratum], end - i);
+				this->mIndexesToJumpOver[stratum] -= skipAmount;
+				this->getStats().onElementsSeen(skipAmount);
+				this->getStats().onElementsSkipped(skipAmount);
+				i += skipAmount;
+				if (i < end)
+				{
+					this->template emplace<true>(stratum, std::ref(elements[mBatchOrder[i]]));
+					++i;
+				}
+			}
+		}
+	}
+
+	// the weighted version of sampleBatch, weights[i] is the weight of elements[i]
+	void sampleWeightedBatch(const size_t* strata, const WeightType* weights, const T* elements, size_t count)
+	{
+		groupByStratum(strata, count);
+
+		for (size_t stratum = 0; stratum < this->mGroupsCount; ++stratum)
+		{
+			for (size_t i = mBatchStrataBegins[stratum]; i < mBatchStrataBegins[stratum + 1]; ++i)
+			{
+				const size_t index = mBatchOrder[i];
+				emplaceWeighted<true>(stratum, weights[index], std::ref(elements[index]));
+			}
+		}
+	}
+
+	size_t getStrataCount() const { return this->mGroupsCount; }
+
+	using Pool::willNextElementBeConsidered;
+	using Pool::skipNextElement;
+
+	// the weighted version of willNextElementBeConsidered
+	bool willNextElementBeConsidered(size_t stratum, WeightType weight) const
+	{
+		assert(stratum < this->mGroupsCount);
+		return (this->mWeightJumpOver[stratum] - weight) <= 0;
+	}
+
+	// the weighted version of skipNextElement
+	void skipNextElement(size_t stratum, WeightType weight)
+	{
+		assert(!willNextElementBeConsidered(stratum, weight));
+		this->mWeightJumpOver[stratum] -= static_cast<RandType>(weight);
+		this->getStats().onElementsSeen(1);
+		this->getStats().onElementsSkipped(1);
+	}
+
+	// writes the state of the pool and the priorities of the strata sampled with weights to the end of buffer
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Stratified, this->getTotalSamplesCount());
+		this->writeGroups(writer, codec);
+
+		for (size_t stratum = 0; stratum < this->mGroupsCount; ++stratum)
+		{
+			const uint8_t hasHeap = mHeapOffsets[stratum] != NoHeap ? 1 : 0;
+			writer.write(hasHeap);
+			if (hasHeap != 0)
+			{
+				// the heap is written in its own order, the strata always use the binary heap
+				const HeapItem* heap = mPriorityHeap.data() + mHeapOffsets[stratum];
+				for (size_t i = 0; i < this->mFilledElementsCount[stratum]; ++i)
+				{
+					writer.write(heap[i].priority);
+					writer.write(heap[i].index);
+				}
+			}
+		}
+	}
+
+	// restores the state written by serialize, the sampler should have the same samples counts of the strata
+	// returns false if the data can't be read, in this case all the strata are left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		this->reset();
+		mHeapOffsets.assign(this->mGroupsCount, NoHeap);
+		mPriorityHeap.clear();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Stratified, this->getTotalSamplesCount())
+			|| !this->readGroups(reader, codec))
+		{
+			return false;
+		}
+
+		for (size_t stratum = 0; stratum < this->mGroupsCount; ++stratum)
+		{
+			uint8_t hasHeap = 0;
+			if (!reader.read(hasHeap))
+			{
+				this->reset();
+				return false;
+			}
+			if (hasHeap == 0)
+			{
+				continue;
+			}
+
+			HeapItem* heap = getHeap(stratum);
+			const size_t filledElementsCount = this->mFilledElementsCount[stratum];
+			for (size_t i = 0; i < filledElementsCount; ++i)
+			{
+				if (!reader.read(heap[i].priority) || !reader.read(heap[i].index) || heap[i].index >= filledElementsCount)
+				{
+					this->reset();
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+private:
+	using HeapPolicy = ReservoirSamplerBinaryHeap;
+	using HeapItem = typename HeapPolicy::template Item<RandType>;
+
+	static constexpr size_t NoHeap = std::numeric_limits<size_t>::max();
+
+private:
+	// counting sort of the indexes of the elements by their strata
+	void groupByStratum(const size_t* strata, size_t count)
+	{
+		const size_t strataCount = this->mGroupsCount;
+		mBatchStrataBegins.assign(strataCount + 1, 0);
+		for (size_t i = 0; i < count; ++i)
+		{
+			assert(strata[i] < strataCount);
+			++mBatchStrataBegins[strata[i] + 1];
+		}
+		for (size_t stratum = 0; stratum < strataCount; ++stratum)
+		{
+			mBatchStrataBegins[stratum + 1] += mBatchStrataBegins[stratum];
+		}
+
+		mBatchOrder.resize(count);
+		mBatchStrataPositions.assign(mBatchStrataBegins.begin(), mBatchStrataBegins.end() - 1);
+		for (size_t i = 0; i < count; ++i)
+		{
+			mBatchOrder[mBatchStrataPositions[strata[i]]++] = i;
+		}
+	}
+
+	// the heap of a stratum is allocated the first time it is sampled with weights and kept after resets
+	HeapItem* getHeap(size_t stratum)
+	{
+		size_t& heapOffset = mHeapOffsets[stratum];
+		if (heapOffset == NoHeap)
+		{
+			heapOffset = mPriorityHeap.size();
+			mPriorityHeap.resize(heapOffset + this->getSamplesCount(stratum));
+			this->getStats().onAllocation();
+		}
+		return mPriorityHeap.data() + heapOffset;
+	}
+
+	// Algorithm A-ExpJ, mWeightJumpOver of the pool is the weight left to jump over
+	// the priorities are stored in log space the same way as in ReservoirSamplerWeighted
+	template<bool isT, typename... Args>
+	void emplaceWeighted(size_t stratum, WeightType weight, Args&&... arguments)
+	{
+		assert(stratum < this->mGroupsCount);
+		this->getStats().onElementsSeen(1);
+
+		if (static_cast<RandType>(weight) <= static_cast<RandType>(0.0))
+		{
+			this->getStats().onElementsSkipped(1);
+			return;
+		}
+
+		RandType& weightJumpOver = this->mWeightJumpOver[stratum];
+		const size_t samplesCount = this->getSamplesCount(stratum);
+		size_t& filledElementsCount = this->mFilledElementsCount[stratum];
+
+		if (filledElementsCount == samplesCount)
+		{
+			weightJumpOver -= static_cast<RandType>(weight);
+			if (weightJumpOver > static_cast<RandType>(0.0))
+			{
+				this->getStats().onElementsSkipped(1);
+				return;
+			}
+		}
+
+		T* elements = this->getGroupElements(stratum);
+		HeapItem* heap = getHeap(stratum);
+
+		if (filledElementsCount < samplesCount)
+		{
+			heap[filledElementsCount] = {std::log(this->generateUniform()) / static_cast<RandType>(weight), filledElementsCount};
+			HeapPolicy::siftUp(heap, filledElementsCount);
+			this->getStats().onHeapOperation();
+			new (elements + filledElementsCount) T(std::forward<Args>(arguments)...);
+			this->getStats().onConstruction();
+			++filledElementsCount;
+		}
+		else
+		{
+			// t = exp(minPriority*w), the new priority is log(t + (1 - t)*u)/w = log(1 - (1 - t)*u')/w with u' = 1 - u
+			const RandType oneMinusT = -std::expm1(heap[0].priority * static_cast<RandType>(weight));
+			const size_t pos = heap[0].index;
+			heap[0].priority = std::log1p(-oneMinusT * this->generateUniform()) / static_cast<RandType>(weight);
+			HeapPolicy::siftDown(heap, samplesCount);
+			this->getStats().onHeapOperation();
+			this->template replaceElement<isT>(elements + pos, std::forward<Args>(arguments)...);
+		}
+
+		if (filledElementsCount == samplesCount)
+		{
+			weightJumpOver = std::log(this->generateUniform()) / heap[0].priority;
+		}
+	}
+
+private:
+	// mHeapOffsets[i] is the position of the heap of stratum i in mPriorityHeap, NoHeap for the uniform strata
+	std::vector<size_t> mHeapOffsets;
+	std::vector<HeapItem> mPriorityHeap;
+	// the buffers for grouping the batches, kept between the calls to not allocate every time
+	std::vector<size_t> mBatchOrder;
+	std::vector<size_t> mBatchStrataBegins;
+	std::vector<size_t> mBatchStrataPositions;
+};
@@ -24,15 +24,30 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <memory>
+#include <functional>
+#include <iterator>
 #include <random>
 #include <type_traits>
 #include <vector>
 
+#include "reservoir_sampler_heap.h"
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_simd.h"
+#include "reservoir_sampler_stats.h"
+
 // ReservoirSamplerWeighted implements Algorithm A-ExpJ for reservoir sampling
 // https://en.wikipedia.org/wiki/Reservoir_sampling#Algorithm_A-ExpJ
-template<typename T, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float>
-class ReservoirSamplerWeighted
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+// Allocator is used to allocate the storage for the elements and the heap (e.g. std::pmr::polymorphic_allocator<std::byte>)
+// HeapPolicy defines the layout of the priority heap, see reservoir_sampler_heap.h
+template<typename T, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats, typename Allocator = std::allocator<std::byte>, typename HeapPolicy = ReservoirSamplerBinaryHeap>
+class ReservoirSamplerWeighted : private StatsPolicy
 {
 public:
 	// C++17 doesn't support std::span, so we can do this instead
@@ -52,33 +67,52 @@ public:
 		const T* end() const { return data + size; }
 	};
 
+private:
+	using HeapItem = typename HeapPolicy::template Item<RandType>;
+	static constexpr size_t HeapPaddingItemsCount = HeapPolicy::template getPaddingItemsCount<HeapItem>();
+
 public:
+	template<typename URNG_T = URNG, typename = std::enable_if_t<std::is_constructible_v<URNG, URNG_T>>>
+	explicit ReservoirSamplerWeighted(size_t samplesCount, URNG_T&& rand = URNG{std::random_device{}()}, const Allocator& allocator = Allocator())
+		: mSamplesCount(samplesCount)
+		, mRand(std::forward<URNG_T>(rand))
+		, mAllocator(allocator)
+	{
+		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		assert(samplesCount > 0);
+		assert(samplesCount <= HeapPolicy::MaxItemsCount);
+	}
+
+	// constructs the sampler over storage provided by the caller instead of allocating it
+	// the storage should be at least getRequiredStorageSize(samplesCount) bytes, be aligned to StorageAlignment and outlive the sampler
 	template<typename URNG_T = URNG>
-	explicit ReservoirSamplerWeighted(size_t samplesCount, URNG_T&& rand = std::mt19937{std::random_device{}()})
+	ReservoirSamplerWeighted(size_t samplesCount, void* storage, URNG_T&& rand = URNG{std::random_device{}()})
 		: mSamplesCount(samplesCount)
 		, mRand(std::forward<URNG_T>(rand))
+		, mHasExternalStorage(true)
 	{
 		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
 		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
 		assert(samplesCount > 0);
+		assert(samplesCount <= HeapPolicy::MaxItemsCount);
+		assert(storage != nullptr && reinterpret_cast<std::uintptr_t>(storage) % StorageAlignment == 0);
+		setData(storage);
 	}
 
 	~ReservoirSamplerWeighted()
 	{
 		reset();
-#ifdef _MSC_VER
-		_aligned_free(mData);
-#else
-		std::free(mData);
-#endif
+		freeData();
 	}
 
 	ReservoirSamplerWeighted(const ReservoirSamplerWeighted& other)
-		: mSamplesCount(other.mSamplesCount)
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
 		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
+		, mAllocator(std::allocator_traits<BlockAllocator>::select_on_container_copy_construction(other.mAllocator))
 	{
 		if (other.mData)
 		{
@@ -86,22 +120,36 @@ public:
 
 			std::memcpy(mPriorityHeap, other.mPriorityHeap, sizeof(HeapItem)*mFilledElementsCount);
 
-			for (size_t i = 0; i < mFilledElementsCount; ++i)
+			if constexpr (std::is_trivially_copyable_v<T>)
 			{
-				new (mElements + i) T(other.mElements[i]);
+				std::memcpy(mElements, other.mElements, sizeof(T)*mFilledElementsCount);
+				for (size_t i = 0; i < mFilledElementsCount; ++i)
+				{
+					this->onConstruction();
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < mFilledElementsCount; ++i)
+				{
+					new (mElements + i) T(other.mElements[i]);
+					this->onConstruction();
+				}
 			}
 		}
 	}
 
 	ReservoirSamplerWeighted(ReservoirSamplerWeighted&& other) noexcept
-		: mSamplesCount(other.mSamplesCount)
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
 		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
+		, mAllocator(std::move(other.mAllocator))
 		, mData(other.mData)
 		, mPriorityHeap(other.mPriorityHeap)
 		, mElements(other.mElements)
+		, mHasExternalStorage(other.mHasExternalStorage)
 	{
 		other.mWeightJumpOver = {};
 		other.mFilledElementsCount = 0;
@@ -130,6 +178,22 @@ public:
 		emplace<false>(weight, std::forward<Args>(arguments)...);
 	}
 
+	// samples count elements with the given weights, the weights should not be negative
+	// elementFunc(index) is called only for the elements that are going to be considered and should return the element with that index
+	// the skipped elements are found by summing float or double weights in blocks (using SIMD instructions when they are available),
+	// then the element that ends the jump is found by going through the weights one by one, the other weight types are only checked one by one
+	template<typename ElementFunc>
+	void sampleWeightedBatch(const WeightType* weights, size_t count, ElementFunc&& elementFunc)
+	{
+		ReservoirSamplerUtils::sampleWeightsBatch(weights, count, mWeightJumpOver,
+			[this] { return mFilledElementsCount < mSamplesCount; },
+			[this, weights, &elementFunc](size_t index) { emplace<true>(weights[index], std::invoke(elementFunc, index)); },
+			[this](size_t skippedCount) {
+				this->onElementsSeen(skippedCount);
+				this->onElementsSkipped(skippedCount);
+			});
+	}
+
 	ResultSpan getResult() const
 	{
 		return ResultSpan(mElements, mFilledElementsCount);
@@ -137,9 +201,7 @@ public:
 
 	std::vector<T> consumeResult()
 	{
-		std::vector<T> result;
-		result.reserve(mFilledElementsCount);
-		std::move(mElements, mElements + mFilledElementsCount, std::back_inserter(result));
+		std::vector<T> result(std::make_move_iterator(mElements), std::make_move_iterator(mElements + mFilledElementsCount));
 
 		reset();
 
@@ -178,35 +240,205 @@ public:
 	{
 		assert(!willNextElementBeConsidered(weight));
 		mWeightJumpOver -= static_cast<RandType>(weight);
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
+	}
+
+	// the total weight of the elements that are going to be skipped before the next considered element
+	// zero while the sampler is not filled, every element is considered then
+	RandType getWeightToJumpOver() const
+	{
+		return mWeightJumpOver;
 	}
 
+	// skips elementsCount elements with the total weight of weight, all of them should be inside of the current jump
+	void jumpAhead(size_t elementsCount, RandType weight)
+	{
+		assert(weight >= static_cast<RandType>(0.0) && weight <= mWeightJumpOver);
+		mWeightJumpOver -= weight;
+		this->onElementsSeen(elementsCount);
+		this->onElementsSkipped(elementsCount);
+	}
+
+	// multiplies the weights of all the elements that went through the sampler by factor
+	// the sampling stays the same, so this can be used to keep the weights in range when they grow over time
+	void scaleWeights(RandType factor)
+	{
+		assert(factor > static_cast<RandType>(0.0));
+		// the priorities are log(u)/w, so dividing all of them by the same factor keeps the heap order
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			mPriorityHeap[i].priority /= factor;
+		}
+		mWeightJumpOver *= factor;
+	}
+
+	// writes the full state of the sampler including the state of the random generator and the elements to the end of buffer
+	// Codec defines how the elements are written, the default one copies the bytes of trivially copyable types
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Weighted, mSamplesCount);
+		writer.write(mWeightJumpOver);
+		ReservoirSamplerUtils::writeRand(writer, mRand);
+		writer.write(mFilledElementsCount);
+
+		// the priorities are written in the order of the elements, so the format doesn't depend on the heap layout
+		std::vector<RandType> priorities(mFilledElementsCount);
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			priorities[mPriorityHeap[i].index] = mPriorityHeap[i].priority;
+		}
+		writer.writeBytes(priorities.data(), sizeof(RandType)*mFilledElementsCount);
+
+		ReservoirSamplerUtils::writeElements(writer, mElements, mFilledElementsCount, codec);
+	}
+
+	// restores the state written by serialize, the sampler should have the same samples count
+	// returns false if the data can't be read, in this case the sampler is left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		RandType weightJumpOver {};
+		size_t filledElementsCount = 0;
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Weighted, mSamplesCount)
+			|| !reader.read(weightJumpOver)
+			|| !ReservoirSamplerUtils::readRand(reader, mRand)
+			|| !reader.read(filledElementsCount)
+			|| filledElementsCount > mSamplesCount)
+		{
+			return false;
+		}
+
+		if (filledElementsCount > 0 && mData == nullptr)
+		{
+			allocateData();
+		}
+
+		for (size_t i = 0; i < filledElementsCount; ++i)
+		{
+			RandType priority {};
+			if (!reader.read(priority))
+			{
+				return false;
+			}
+			mPriorityHeap[i] = {priority, static_cast<decltype(HeapItem::index)>(i)};
+			HeapPolicy::siftUp(mPriorityHeap, i);
+		}
+
+		mFilledElementsCount = ReservoirSamplerUtils::readElements(reader, mElements, filledElementsCount, codec);
+		if (mFilledElementsCount != filledElementsCount)
+		{
+			reset();
+			return false;
+		}
+
+		mWeightJumpOver = weightJumpOver;
+		return true;
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
 	// optionally use if you don't want to delay the memory allocation to the moment of adding the first element
 	void allocateData()
 	{
 		assert(mData == nullptr);
-		constexpr size_t alignment = std::max(std::alignment_of_v<HeapItem>, std::alignment_of_v<T>);
-		const size_t heapExtent = (sizeof(HeapItem)*mSamplesCount) % std::alignment_of_v<T>;
-		const size_t elementsAlignmentGap = heapExtent > 0 ? (std::alignment_of_v<T> - heapExtent) : 0;
-		const size_t elementsOffset = sizeof(HeapItem)*mSamplesCount + elementsAlignmentGap;
-		const size_t alignedSize = elementsOffset + sizeof(T)*mSamplesCount;
-
-#ifdef _MSC_VER // MSVC doesn't support std::aligned_alloc
-		mData = _aligned_malloc(alignedSize, alignment);
-#else
-		mData = std::aligned_alloc(alignment, alignedSize);
-#endif
-		mPriorityHeap = reinterpret_cast<HeapItem*>(mData);
-		mElements = reinterpret_cast<T*>(static_cast<char*>(mData) + elementsOffset);
+		setData(std::allocator_traits<BlockAllocator>::allocate(mAllocator, getBlocksCount(mSamplesCount)));
+		this->onAllocation();
+	}
+
+	static constexpr size_t StorageAlignment = std::max(HeapPolicy::template getAlignment<HeapItem>(), std::alignment_of_v<T>);
+
+	// size in bytes of the storage that should be provided to the constructor taking external storage
+	// the heap and the elements are stored in one block
+	static constexpr size_t getRequiredStorageSize(size_t samplesCount)
+	{
+		return getElementsOffset(samplesCount) + sizeof(T)*samplesCount;
+	}
+
+	// merges the result of another sampler into this one, so the result is as if all the elements
+	// that went through the other sampler also went through this one
+	// can be used to sample a stream in parallel and then merge the results, both samplers should have the same samples count
+	void merge(const ReservoirSamplerWeighted& other)
+	{
+		assert(this != &other);
+		assert(mSamplesCount == other.mSamplesCount);
+
+		if (other.mFilledElementsCount == 0)
+		{
+			return;
+		}
+
+		if (mData == nullptr)
+		{
+			allocateData();
+		}
+
+		// the result of A-ExpJ is the elements with the highest priorities, so we just keep the best of both
+		for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+		{
+			const HeapItem& item = other.mPriorityHeap[i];
+			if (mFilledElementsCount < mSamplesCount)
+			{
+				insertSorted(item.priority, other.mElements[item.index]);
+			}
+			else if (item.priority > mPriorityHeap[0].priority)
+			{
+				insertSortedRemoveFirst<true>(item.priority, other.mElements[item.index]);
+			}
+		}
+
+		// the jump is exponentially distributed, so it is fine to regenerate it for the new threshold
+		if (mFilledElementsCount == mSamplesCount)
+		{
+			mWeightJumpOver = std::log(generateUniform()) / mPriorityHeap[0].priority;
+		}
 	}
 
 private:
-	struct HeapItem
+	// the allocator is rebound to blocks with the storage alignment, so the allocated memory is always properly aligned
+	struct alignas(StorageAlignment) AllocationBlock
 	{
-		RandType priority;
-		size_t index;
+		std::byte data[StorageAlignment];
 	};
 
+	using BlockAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<AllocationBlock>;
+
 private:
+	static constexpr size_t getElementsOffset(size_t samplesCount)
+	{
+		const size_t heapSize = sizeof(HeapItem)*(HeapPaddingItemsCount + samplesCount);
+		const size_t heapExtent = heapSize % std::alignment_of_v<T>;
+		const size_t elementsAlignmentGap = heapExtent > 0 ? (std::alignment_of_v<T> - heapExtent) : 0;
+		return heapSize + elementsAlignmentGap;
+	}
+
+	static size_t getBlocksCount(size_t samplesCount)
+	{
+		return (getRequiredStorageSize(samplesCount) + sizeof(AllocationBlock) - 1) / sizeof(AllocationBlock);
+	}
+
+	void setData(void* data)
+	{
+		mData = data;
+		mPriorityHeap = reinterpret_cast<HeapItem*>(mData) + HeapPaddingItemsCount;
+		mElements = reinterpret_cast<T*>(static_cast<char*>(mData) + getElementsOffset(mSamplesCount));
+	}
+
+	void freeData()
+	{
+		if (mData != nullptr && !mHasExternalStorage)
+		{
+			std::allocator_traits<BlockAllocator>::deallocate(mAllocator, static_cast<AllocationBlock*>(mData), getBlocksCount(mSamplesCount));
+		}
+	}
+
 	template<bool isT, typename... Args>
 	void emplace(WeightType weight, Args&&... arguments)
 	{
@@ -215,15 +447,22 @@ private:
 			allocateData();
 		}
 
-		if (static_cast<RandType>(weight) > static_cast<RandType>(0.0))
+		this->onElementsSeen(1);
+
+		if (static_cast<RandType>(weight) <= static_cast<RandType>(0.0))
+		{
+			this->onElementsSkipped(1);
+		}
+		else
 		{
 			if (mFilledElementsCount < mSamplesCount)
 			{
-				const RandType r = std::pow(mUniformDist(mRand), static_cast<RandType>(1.0) / static_cast<RandType>(weight));
+				// the priorities are stored in log space (log(u^(1/w)) = log(u)/w), which avoids pow and keeps the precision for big weights
+				const RandType r = std::log(generateUniform()) / static_cast<RandType>(weight);
 				insertSorted(r, std::forward<Args>(arguments)...);
 				if (mFilledElementsCount == mSamplesCount)
 				{
-					mWeightJumpOver = std::log(mUniformDist(mRand)) / std::log(mPriorityHeap[0].priority);
+					mWeightJumpOver = std::log(generateUniform()) / mPriorityHeap[0].priority;
 				}
 			}
 			else
@@ -231,12 +470,17 @@ private:
 				mWeightJumpOver -= static_cast<RandType>(weight);
 				if (mWeightJumpOver <= static_cast<RandType>(0.0))
 				{
-					const RandType t = std::pow(mPriorityHeap[0].priority, static_cast<RandType>(weight));
-					const RandType r = std::pow(std::uniform_real_distribution<RandType>(t, static_cast<RandType>(1.0))(mRand), static_cast<RandType>(1.0) / static_cast<RandType>(weight));
+					// t = exp(minPriority*w), the new priority is log(t + (1 - t)*u)/w = log(1 - (1 - t)*u')/w with u' = 1 - u
+					const RandType oneMinusT = -std::expm1(mPriorityHeap[0].priority * static_cast<RandType>(weight));
+					const RandType r = std::log1p(-oneMinusT * generateUniform()) / static_cast<RandType>(weight);
 
 					insertSortedRemoveFirst<isT>(r, std::forward<Args>(arguments)...);
 
-					mWeightJumpOver = std::log(mUniformDist(mRand)) / std::log(mPriorityHeap[0].priority);
+					mWeightJumpOver = std::log(generateUniform()) / mPriorityHeap[0].priority;
+				}
+				else
+				{
+					this->onElementsSkipped(1);
 				}
 			}
 		}
@@ -245,44 +489,57 @@ private:
 	template<typename... Args>
 	void insertSorted(RandType r, Args&&... arguments)
 	{
-		mPriorityHeap[mFilledElementsCount] = {r, mFilledElementsCount};
-		std::push_heap(mPriorityHeap, mPriorityHeap + mFilledElementsCount + 1, [](const HeapItem& a, const HeapItem& b){ return a.priority > b.priority; });
+		mPriorityHeap[mFilledElementsCount] = {r, static_cast<decltype(HeapItem::index)>(mFilledElementsCount)};
+		HeapPolicy::siftUp(mPriorityHeap, mFilledElementsCount);
+		this->onHeapOperation();
 
 		new (mElements + mFilledElementsCount) T(std::forward<Args>(arguments)...);
+		this->onConstruction();
 		++mFilledElementsCount;
 	}
 
 	template<bool isT, typename... Args>
 	void insertSortedRemoveFirst(RandType r, Args&&... arguments)
 	{
-		std::pop_heap(mPriorityHeap, mPriorityHeap + mSamplesCount, [](const HeapItem& a, const HeapItem& b){ return a.priority > b.priority; });
-		const size_t oldElementIdx = mPriorityHeap[mSamplesCount - 1].index;
+		const size_t oldElementIdx = mPriorityHeap[0].index;
 
-		mPriorityHeap[mSamplesCount - 1] = {r, oldElementIdx};
-		std::push_heap(mPriorityHeap, mPriorityHeap + mSamplesCount, [](const HeapItem& a, const HeapItem& b){ return a.priority > b.priority; });
+		mPriorityHeap[0].priority = r;
+		HeapPolicy::siftDown(mPriorityHeap, mSamplesCount);
+		this->onHeapOperation();
 
 		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
 		{
 			mElements[oldElementIdx] = std::forward<Args...>(arguments...);
+			this->onAssignment();
 		}
 		else if constexpr (std::is_move_assignable_v<T>)
 		{
 			mElements[oldElementIdx] = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
 		}
 		else
 		{
 			mElements[oldElementIdx].~T();
 			new (mElements + oldElementIdx) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
 		}
 	}
 
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mRand);
+	}
+
 private:
 	const size_t mSamplesCount;
 	RandType mWeightJumpOver {};
 	URNG mRand;
-	std::uniform_real_distribution<RandType> mUniformDist{static_cast<RandType>(0.0), static_cast<RandType>(1.0)};
 	size_t mFilledElementsCount = 0;
+	BlockAllocator mAllocator;
 	void* mData = nullptr;
 	HeapItem* mPriorityHeap = nullptr;
 	T* mElements = nullptr;
+	bool mHasExternalStorage = false;
 };
@@ -0,0 +1,236 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reservoir_sampler_heap.h"
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerWeightedPacked implements Algorithm A-ExpJ the same way as ReservoirSamplerWeighted,
+// but stores every element right next to its priority in the heap instead of keeping an index to a separate array
+// This removes one indirection per replacement and makes the storage smaller for small trivially copyable types (e.g. ids),
+// however the elements are moved together with the priorities when the heap is updated, so it is not worth it for big types
+// The result is not stored contiguously, so it is accessed by index or consumed into a vector
+//
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+// HeapPolicy defines the layout of the priority heap, see reservoir_sampler_heap.h
+template<typename T, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats, typename HeapPolicy = ReservoirSamplerBinaryHeap>
+class ReservoirSamplerWeightedPacked : private StatsPolicy
+{
+public:
+	struct Item
+	{
+		RandType priority;
+		T element;
+	};
+
+public:
+	template<typename URNG_T = URNG, typename = std::enable_if_t<std::is_constructible_v<URNG, URNG_T>>>
+	explicit ReservoirSamplerWeightedPacked(size_t samplesCount, URNG_T&& rand = URNG{std::random_device{}()})
+		: mSamplesCount(samplesCount)
+		, mRand(std::forward<URNG_T>(rand))
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "T should be trivially copyable");
+		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
+		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
+		assert(samplesCount > 0);
+	}
+
+	ReservoirSamplerWeightedPacked(const ReservoirSamplerWeightedPacked& other)
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
+		, mWeightJumpOver(other.mWeightJumpOver)
+		, mRand(other.mRand)
+		, mFilledElementsCount(other.mFilledElementsCount)
+		, mStorage(other.mStorage)
+	{
+		if (!mStorage.empty())
+		{
+			mHeap = reinterpret_cast<Item*>(mStorage.data()) + HeapPaddingItemsCount;
+		}
+	}
+
+	ReservoirSamplerWeightedPacked(ReservoirSamplerWeightedPacked&& other) noexcept
+		: StatsPolicy(other)
+		, mSamplesCount(other.mSamplesCount)
+		, mWeightJumpOver(other.mWeightJumpOver)
+		, mRand(std::move(other.mRand))
+		, mFilledElementsCount(other.mFilledElementsCount)
+		, mStorage(std::move(other.mStorage))
+		, mHeap(other.mHeap)
+	{
+		other.mWeightJumpOver = {};
+		other.mFilledElementsCount = 0;
+		other.mStorage.clear();
+		other.mHeap = nullptr;
+	}
+
+	ReservoirSamplerWeightedPacked& operator=(const ReservoirSamplerWeightedPacked&) = delete;
+	ReservoirSamplerWeightedPacked& operator=(ReservoirSamplerWeightedPacked&&) = delete;
+
+	void sampleElement(WeightType weight, const T& element)
+	{
+		this->onElementsSeen(1);
+
+		if (static_cast<RandType>(weight) <= static_cast<RandType>(0.0))
+		{
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		if (mFilledElementsCount < mSamplesCount)
+		{
+			if (mHeap == nullptr)
+			{
+				allocateData();
+			}
+
+			new (mHeap + mFilledElementsCount) Item{std::log(generateUniform()) / static_cast<RandType>(weight), element};
+			HeapPolicy::siftUp(mHeap, mFilledElementsCount);
+			++mFilledElementsCount;
+			this->onHeapOperation();
+			this->onConstruction();
+
+			if (mFilledElementsCount == mSamplesCount)
+			{
+				mWeightJumpOver = std::log(generateUniform()) / mHeap[0].priority;
+			}
+			return;
+		}
+
+		mWeightJumpOver -= static_cast<RandType>(weight);
+		if (mWeightJumpOver > static_cast<RandType>(0.0))
+		{
+			this->onElementsSkipped(1);
+			return;
+		}
+
+		// t = exp(minPriority*w), the new priority is log(t + (1 - t)*u)/w = log(1 - (1 - t)*u')/w with u' = 1 - u
+		const RandType oneMinusT = -std::expm1(mHeap[0].priority * static_cast<RandType>(weight));
+		mHeap[0] = {std::log1p(-oneMinusT * generateUniform()) / static_cast<RandType>(weight), element};
+		HeapPolicy::siftDown(mHeap, mSamplesCount);
+		this->onHeapOperation();
+		this->onAssignment();
+
+		mWeightJumpOver = std::log(generateUniform()) / mHeap[0].priority;
+	}
+
+	const T& getResultElement(size_t index) const
+	{
+		assert(index < mFilledElementsCount);
+		return mHeap[index].element;
+	}
+
+	size_t getResultSize() const { return mFilledElementsCount; }
+
+	std::vector<T> consumeResult()
+	{
+		std::vector<T> result;
+		result.reserve(mFilledElementsCount);
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			result.push_back(mHeap[i].element);
+		}
+
+		reset();
+
+		return result;
+	}
+
+	// outRawData should point to a C-array with enough memory to fit getResultSize() elements
+	void consumeResultTo(T* outRawData)
+	{
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			*outRawData++ = mHeap[i].element;
+		}
+		reset();
+	}
+
+	// resets the state of the sampling, the storage is kept for the next sampling
+	void reset()
+	{
+		mFilledElementsCount = 0;
+		mWeightJumpOver = {};
+	}
+
+	// optionally use this function in combination with skipNextElement in case creation of an object is expensive
+	// you can call skipNextElement every time this method returns false as in these cases the objects will be skipped
+	bool willNextElementBeConsidered(WeightType weight) const
+	{
+		return (mWeightJumpOver - weight) <= 0;
+	}
+
+	// optionally use this in combination with willNextElementBeConsidered, refer to the comment above willNextElementBeConsidered
+	void skipNextElement(WeightType weight)
+	{
+		assert(!willNextElementBeConsidered(weight));
+		mWeightJumpOver -= static_cast<RandType>(weight);
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+private:
+	static constexpr size_t HeapPaddingItemsCount = HeapPolicy::template getPaddingItemsCount<Item>();
+	static constexpr size_t StorageAlignment = HeapPolicy::template getAlignment<Item>();
+
+	// the storage is allocated in blocks of the alignment that HeapPolicy expects for the groups of children
+	struct alignas(StorageAlignment) AllocationBlock
+	{
+		std::byte data[StorageAlignment];
+	};
+
+private:
+	void allocateData()
+	{
+		const size_t heapSize = sizeof(Item)*(HeapPaddingItemsCount + mSamplesCount);
+		mStorage.resize((heapSize + sizeof(AllocationBlock) - 1) / sizeof(AllocationBlock));
+		mHeap = reinterpret_cast<Item*>(mStorage.data()) + HeapPaddingItemsCount;
+		this->onAllocation();
+	}
+
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mRand);
+	}
+
+private:
+	const size_t mSamplesCount;
+	RandType mWeightJumpOver {};
+	URNG mRand;
+	size_t mFilledElementsCount = 0;
+	std::vector<AllocationBlock> mStorage;
+	Item* mHeap = nullptr;
+};
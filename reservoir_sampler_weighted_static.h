@@ -24,17 +24,28 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstring>
+#include <functional>
+#include <iterator>
 #include <random>
 #include <type_traits>
 #include <vector>
 
+#include "reservoir_sampler_heap.h"
+#include "reservoir_sampler_random.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_simd.h"
+#include "reservoir_sampler_stats.h"
+
 // ReservoirSamplerWeightedStatic implements Algorithm A-ExpJ for reservoir sampling
 // https://en.wikipedia.org/wiki/Reservoir_sampling#Algorithm_A-ExpJ
 // Objects of the class don't allocate memory on heap (unless stored types allocate data themselves)
-template<typename T, size_t SamplesCount, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float>
-class ReservoirSamplerWeightedStatic
+// StatsPolicy allows to collect stats about the sampling, see reservoir_sampler_stats.h
+// HeapPolicy defines the layout of the priority heap, see reservoir_sampler_heap.h
+template<typename T, size_t SamplesCount, typename WeightType = float, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats, typename HeapPolicy = ReservoirSamplerBinaryHeap>
+class ReservoirSamplerWeightedStatic : private StatsPolicy
 {
 public:
 	// C++17 doesn't support std::span, so we can do this instead
@@ -55,13 +66,14 @@ public:
 	};
 
 public:
-	template<typename URNG_T = URNG, typename = std::enable_if_t<!std::is_same_v<std::decay_t<URNG_T>, ReservoirSamplerWeightedStatic<T, SamplesCount, WeightType, URNG, RandType>>>>
-	explicit ReservoirSamplerWeightedStatic(URNG_T&& rand = std::mt19937{std::random_device{}()})
+	template<typename URNG_T = URNG, typename = std::enable_if_t<!std::is_same_v<std::decay_t<URNG_T>, ReservoirSamplerWeightedStatic<T, SamplesCount, WeightType, URNG, RandType, StatsPolicy, HeapPolicy>>>>
+	explicit ReservoirSamplerWeightedStatic(URNG_T&& rand = URNG{std::random_device{}()})
 		: mRand(std::forward<URNG_T>(rand))
 	{
 		static_assert(std::is_arithmetic_v<WeightType>, "WeightType should be arithmetic type");
 		static_assert(std::is_floating_point_v<RandType>, "RandType should be floating point type");
 		static_assert(SamplesCount > 0, "SamplesCount should not be zero");
+		static_assert(SamplesCount <= HeapPolicy::MaxItemsCount, "SamplesCount should fit into the heap index type");
 	}
 
 	~ReservoirSamplerWeightedStatic()
@@ -70,60 +82,50 @@ public:
 	}
 
 	ReservoirSamplerWeightedStatic(const ReservoirSamplerWeightedStatic& other)
-		: mWeightJumpOver(other.mWeightJumpOver)
+		: StatsPolicy(other)
+		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
 	{
 		std::memcpy(mPriorityHeap, other.mPriorityHeap, sizeof(HeapItem)*mFilledElementsCount);
 
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(other.mElements[i]);
-		}
+		copyElementsFrom(other);
 	}
 
 	ReservoirSamplerWeightedStatic(ReservoirSamplerWeightedStatic&& other) noexcept
-		: mWeightJumpOver(other.mWeightJumpOver)
+		: StatsPolicy(other)
+		, mWeightJumpOver(other.mWeightJumpOver)
 		, mRand(other.mRand)
-		, mUniformDist(other.mUniformDist)
 		, mFilledElementsCount(other.mFilledElementsCount)
 	{
 		std::memcpy(mPriorityHeap, other.mPriorityHeap, sizeof(HeapItem)*mFilledElementsCount);
 
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(std::move(other.mElements[i]));
-		}
+		moveElementsFrom(other);
 
 		other.reset();
 	}
 
 	ReservoirSamplerWeightedStatic& operator=(const ReservoirSamplerWeightedStatic& other) {
 		reset();
+		StatsPolicy::operator=(other);
 		mWeightJumpOver = other.mWeightJumpOver;
 		mFilledElementsCount = other.mFilledElementsCount;
 
 		std::memcpy(mPriorityHeap, other.mPriorityHeap, sizeof(HeapItem)*mFilledElementsCount);
 
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(other.mElements[i]);
-		}
+		copyElementsFrom(other);
 		return *this;
 	}
 
 	ReservoirSamplerWeightedStatic& operator=(ReservoirSamplerWeightedStatic&& other) noexcept {
 		reset();
+		StatsPolicy::operator=(other);
 		mWeightJumpOver = other.mWeightJumpOver;
 		mFilledElementsCount = other.mFilledElementsCount;
 
 		std::memcpy(mPriorityHeap, other.mPriorityHeap, sizeof(HeapItem)*mFilledElementsCount);
 
-		for (size_t i = 0; i < mFilledElementsCount; ++i)
-		{
-			new (mElements + i) T(std::move(other.mElements[i]));
-		}
+		moveElementsFrom(other);
 		other.reset();
 		return *this;
 	}
@@ -145,6 +147,22 @@ public:
 		emplace<false>(weight, std::forward<Args>(arguments)...);
 	}
 
+	// samples count elements with the given weights, the weights should not be negative
+	// elementFunc(index) is called only for the elements that are going to be considered and should return the element with that index
+	// the skipped elements are found by summing float or double weights in blocks (using SIMD instructions when they are available),
+	// then the element that ends the jump is found by going through the weights one by one, the other weight types are only checked one by one
+	template<typename ElementFunc>
+	void sampleWeightedBatch(const WeightType* weights, size_t count, ElementFunc&& elementFunc)
+	{
+		ReservoirSamplerUtils::sampleWeightsBatch(weights, count, mWeightJumpOver,
+			[this] { return mFilledElementsCount < SamplesCount; },
+			[this, weights, &elementFunc](size_t index) { emplace<true>(weights[index], std::invoke(elementFunc, index)); },
+			[this](size_t skippedCount) {
+				this->onElementsSeen(skippedCount);
+				this->onElementsSkipped(skippedCount);
+			});
+	}
+
 	ResultSpan getResult() const
 	{
 		return ResultSpan(mElements, mFilledElementsCount);
@@ -152,9 +170,7 @@ public:
 
 	std::vector<T> consumeResult()
 	{
-		std::vector<T> result;
-		result.reserve(mFilledElementsCount);
-		std::move(mElements, mElements + mFilledElementsCount, std::back_inserter(result));
+		std::vector<T> result(std::make_move_iterator(mElements), std::make_move_iterator(mElements + mFilledElementsCount));
 
 		reset();
 
@@ -193,29 +209,151 @@ public:
 	{
 		assert(!willNextElementBeConsidered(weight));
 		mWeightJumpOver -= static_cast<RandType>(weight);
+		this->onElementsSeen(1);
+		this->onElementsSkipped(1);
 	}
 
-private:
-	struct HeapItem
+	// multiplies the weights of all the elements that went through the sampler by factor
+	// the sampling stays the same, so this can be used to keep the weights in range when they grow over time
+	void scaleWeights(RandType factor)
 	{
-		RandType priority;
-		size_t index;
-	};
+		assert(factor > static_cast<RandType>(0.0));
+		// the priorities are log(u)/w, so dividing all of them by the same factor keeps the heap order
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			mPriorityHeap[i].priority /= factor;
+		}
+		mWeightJumpOver *= factor;
+	}
+
+	// writes the full state of the sampler including the state of the random generator and the elements to the end of buffer
+	// Codec defines how the elements are written, the default one copies the bytes of trivially copyable types
+	// see reservoir_sampler_serialization.h for the details about the format and the codecs
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::WeightedStatic, SamplesCount);
+		writer.write(mWeightJumpOver);
+		ReservoirSamplerUtils::writeRand(writer, mRand);
+		writer.write(mFilledElementsCount);
+
+		// the priorities are written in the order of the elements, so the format doesn't depend on the heap layout
+		std::vector<RandType> priorities(mFilledElementsCount);
+		for (size_t i = 0; i < mFilledElementsCount; ++i)
+		{
+			priorities[mPriorityHeap[i].index] = mPriorityHeap[i].priority;
+		}
+		writer.writeBytes(priorities.data(), sizeof(RandType)*mFilledElementsCount);
+
+		ReservoirSamplerUtils::writeElements(writer, mElements, mFilledElementsCount, codec);
+	}
+
+	// restores the state written by serialize, the sampler should have the same samples count
+	// returns false if the data can't be read, in this case the sampler is left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		RandType weightJumpOver {};
+		size_t filledElementsCount = 0;
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::WeightedStatic, SamplesCount)
+			|| !reader.read(weightJumpOver)
+			|| !ReservoirSamplerUtils::readRand(reader, mRand)
+			|| !reader.read(filledElementsCount)
+			|| filledElementsCount > SamplesCount)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < filledElementsCount; ++i)
+		{
+			RandType priority {};
+			if (!reader.read(priority))
+			{
+				return false;
+			}
+			mPriorityHeap[i] = {priority, static_cast<decltype(HeapItem::index)>(i)};
+			HeapPolicy::siftUp(mPriorityHeap, i);
+		}
+
+		mFilledElementsCount = ReservoirSamplerUtils::readElements(reader, mElements, filledElementsCount, codec);
+		if (mFilledElementsCount != filledElementsCount)
+		{
+			reset();
+			return false;
+		}
+
+		mWeightJumpOver = weightJumpOver;
+		return true;
+	}
+
+	const StatsPolicy& getStats() const { return *this; }
+	StatsPolicy& getStats() { return *this; }
+
+private:
+	using HeapItem = typename HeapPolicy::template Item<RandType>;
+	static constexpr size_t HeapPaddingItemsCount = HeapPolicy::template getPaddingItemsCount<HeapItem>();
 
 private:
+	// trivially copyable elements are copied as one block, but still counted as constructed in the stats
+	void copyElementsFrom(const ReservoirSamplerWeightedStatic& other)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			std::memcpy(mElements, other.mElements, sizeof(T)*other.mFilledElementsCount);
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				this->onConstruction();
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				new (mElements + i) T(other.mElements[i]);
+				this->onConstruction();
+			}
+		}
+	}
+
+	void moveElementsFrom(ReservoirSamplerWeightedStatic& other)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			copyElementsFrom(other);
+		}
+		else
+		{
+			for (size_t i = 0; i < other.mFilledElementsCount; ++i)
+			{
+				new (mElements + i) T(std::move(other.mElements[i]));
+				this->onConstruction();
+			}
+		}
+	}
+
 	template<bool isT, typename... Args>
 	void emplace(WeightType weight, Args&&... arguments)
 	{
-		if (static_cast<RandType>(weight) > static_cast<RandType>(0.0))
+		this->onElementsSeen(1);
+
+		if (static_cast<RandType>(weight) <= static_cast<RandType>(0.0))
+		{
+			this->onElementsSkipped(1);
+		}
+		else
 		{
 			if (mFilledElementsCount < SamplesCount)
 			{
-				const float rand = mUniformDist(mRand);
-				const RandType r = std::pow(rand, static_cast<RandType>(1.0) / static_cast<RandType>(weight));
+				// the priorities are stored in log space (log(u^(1/w)) = log(u)/w), which avoids pow and keeps the precision for big weights
+				const RandType r = std::log(generateUniform()) / static_cast<RandType>(weight);
 				insertSorted(r, std::forward<Args>(arguments)...);
 				if (mFilledElementsCount == SamplesCount)
 				{
-					mWeightJumpOver = std::log(mUniformDist(mRand)) / std::log(mPriorityHeap[0].priority);
+					mWeightJumpOver = std::log(generateUniform()) / mPriorityHeap[0].priority;
 				}
 			}
 			else
@@ -223,12 +361,17 @@ private:
 				mWeightJumpOver -= static_cast<RandType>(weight);
 				if (mWeightJumpOver <= static_cast<RandType>(0.0))
 				{
-					const RandType t = std::pow(mPriorityHeap[0].priority, static_cast<RandType>(weight));
-					const RandType r = std::pow(std::uniform_real_distribution<RandType>(t, static_cast<RandType>(1.0))(mRand), static_cast<RandType>(1.0) / static_cast<RandType>(weight));
+					// t = exp(minPriority*w), the new priority is log(t + (1 - t)*u)/w = log(1 - (1 - t)*u')/w with u' = 1 - u
+					const RandType oneMinusT = -std::expm1(mPriorityHeap[0].priority * static_cast<RandType>(weight));
+					const RandType r = std::log1p(-oneMinusT * generateUniform()) / static_cast<RandType>(weight);
 
 					insertSortedRemoveFirst<isT>(r, std::forward<Args>(arguments)...);
 
-					mWeightJumpOver = std::log(mUniformDist(mRand)) / std::log(mPriorityHeap[0].priority);
+					mWeightJumpOver = std::log(generateUniform()) / mPriorityHeap[0].priority;
+				}
+				else
+				{
+					this->onElementsSkipped(1);
 				}
 			}
 		}
@@ -237,44 +380,55 @@ private:
 	template<typename... Args>
 	void insertSorted([[maybe_unused]]RandType r, Args&&... arguments)
 	{
-		mPriorityHeap[mFilledElementsCount] = {r, mFilledElementsCount};
-		std::push_heap(mPriorityHeap, mPriorityHeap + mFilledElementsCount + 1, [](const HeapItem& a, const HeapItem& b){ return a.priority > b.priority; });
+		mPriorityHeap[mFilledElementsCount] = {r, static_cast<decltype(HeapItem::index)>(mFilledElementsCount)};
+		HeapPolicy::siftUp(mPriorityHeap, mFilledElementsCount);
+		this->onHeapOperation();
 
 		new (mElements + mFilledElementsCount) T(std::forward<Args>(arguments)...);
+		this->onConstruction();
 		++mFilledElementsCount;
 	}
 
 	template<bool isT, typename... Args>
 	void insertSortedRemoveFirst(RandType r, Args&&... arguments)
 	{
-		std::pop_heap(mPriorityHeap, mPriorityHeap + SamplesCount, [](const HeapItem& a, const HeapItem& b){ return a.priority > b.priority; });
-		const size_t oldElementIdx = mPriorityHeap[SamplesCount - 1].index;
+		const size_t oldElementIdx = mPriorityHeap[0].index;
 
-		mPriorityHeap[SamplesCount - 1] = {r, oldElementIdx};
-		std::push_heap(mPriorityHeap, mPriorityHeap + SamplesCount, [](const HeapItem& a, const HeapItem& b){ return a.priority > b.priority; });
+		mPriorityHeap[0].priority = r;
+		HeapPolicy::siftDown(mPriorityHeap, SamplesCount);
+		this->onHeapOperation();
 
 		if constexpr (isT && (std::is_move_assignable_v<T> || std::is_copy_assignable_v<T>))
 		{
 			mElements[oldElementIdx] = std::forward<Args...>(arguments...);
+			this->onAssignment();
 		}
 		else if constexpr (std::is_move_assignable_v<T>)
 		{
 			mElements[oldElementIdx] = T(std::forward<Args>(arguments)...);
+			this->onConstruction();
+			this->onAssignment();
 		}
 		else
 		{
 			mElements[oldElementIdx].~T();
 			new (mElements + oldElementIdx) T(std::forward<Args>(arguments)...);
+			this->onConstruction();
 		}
 	}
 
+	RandType generateUniform()
+	{
+		this->onRandomCall();
+		return ReservoirSamplerUtils::generateUniform<RandType>(mRand);
+	}
+
 private:
 	RandType mWeightJumpOver {};
 	URNG mRand;
-	std::uniform_real_distribution<RandType> mUniformDist{static_cast<RandType>(0.0), static_cast<RandType>(1.0)};
 	size_t mFilledElementsCount = 0;
-	alignas(HeapItem) std::byte mHeapData[sizeof(HeapItem)*SamplesCount];
+	alignas(HeapPolicy::template getAlignment<HeapItem>()) std::byte mHeapData[sizeof(HeapItem)*(HeapPaddingItemsCount + SamplesCount)];
 	alignas(T) std::byte mData[sizeof(T)*SamplesCount];
-	HeapItem* const mPriorityHeap = reinterpret_cast<HeapItem*>(mHeapData);
+	HeapItem* const mPriorityHeap = reinterpret_cast<HeapItem*>(mHeapData) + HeapPaddingItemsCount;
 	T* const mElements = reinterpret_cast<T*>(mData);
 };
@@ -0,0 +1,239 @@
+// MIT License
+
+// Copyright (c) 2022 Pavel Grebnev
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reservoir_sampler.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_stats.h"
+
+// ReservoirSamplerWindowed samples uniformly from the elements of a sliding window, e.g. the last 10 minutes
+// The window is split into bucketsCount buckets of bucketDuration each, every bucket is a separate ReservoirSampler
+// When the time moves to a new bucket, the oldest bucket is reset and reused, the live buckets are merged when the result is requested
+// This way the memory is bounded by bucketsCount * samplesCount elements, and the cost per element is the same as for ReservoirSampler
+// The window is approximated to the bucket granularity: it covers the current (partially filled) bucket and bucketsCount - 1 previous ones
+// TimeType can be a timestamp or an element index for count-based windows, the time should not be negative
+// StatsPolicy is used by the buckets, see reservoir_sampler_stats.h
+template<typename T, typename TimeType = uint64_t, typename URNG = std::mt19937, typename RandType = float, typename StatsPolicy = ReservoirSamplerNoStats>
+class ReservoirSamplerWindowed
+{
+public:
+	using Sampler = ReservoirSampler<T, URNG, RandType, StatsPolicy>;
+
+public:
+	template<typename URNG_T = URNG>
+	ReservoirSamplerWindowed(size_t samplesCount, size_t bucketsCount, TimeType bucketDuration, URNG_T&& rand = URNG{std::random_device{}()})
+		: mSamplesCount(samplesCount)
+		, mBucketDuration(bucketDuration)
+		, mRand(std::forward<URNG_T>(rand))
+		, mBucketEpochs(bucketsCount, 0)
+	{
+		static_assert(std::is_arithmetic_v<TimeType>, "TimeType should be arithmetic type");
+		assert(samplesCount > 0);
+		assert(bucketsCount > 0);
+		assert(bucketDuration > TimeType{});
+
+		mBuckets.reserve(bucketsCount);
+		for (size_t i = 0; i < bucketsCount; ++i)
+		{
+			mBuckets.emplace_back(samplesCount, makeRand());
+		}
+	}
+
+	template<typename E, typename = std::enable_if_t<!std::is_lvalue_reference_v<E> && std::is_move_constructible_v<T> && std::is_same_v<std::decay_t<E>, T>>>
+	void sampleElement(TimeType time, E&& element)
+	{
+		if (Sampler* bucket = getBucket(time))
+		{
+			bucket->sampleElement(std::move(element));
+		}
+	}
+
+	void sampleElement(TimeType time, const T& element)
+	{
+		if (Sampler* bucket = getBucket(time))
+		{
+			bucket->sampleElement(element);
+		}
+	}
+
+	template<typename... Args>
+	void sampleElementEmplace(TimeType time, Args&&... arguments)
+	{
+		if (Sampler* bucket = getBucket(time))
+		{
+			bucket->sampleElementEmplace(std::forward<Args>(arguments)...);
+		}
+	}
+
+	// returns a sampler with the merged state of the buckets that are still in the window at currentTime
+	Sampler getSnapshot(TimeType currentTime)
+	{
+		Sampler result(mSamplesCount, makeRand());
+		const size_t currentEpoch = getEpoch(currentTime);
+		for (size_t i = 0; i < mBuckets.size(); ++i)
+		{
+			if (isEpochInWindow(mBucketEpochs[i], currentEpoch))
+			{
+				result.merge(mBuckets[i]);
+			}
+		}
+		return result;
+	}
+
+	std::vector<T> getResult(TimeType currentTime)
+	{
+		return getSnapshot(currentTime).consumeResult();
+	}
+
+	// fully resets the state and cleans all the stored data
+	void reset()
+	{
+		for (Sampler& bucket : mBuckets)
+		{
+			bucket.reset();
+		}
+		std::fill(mBucketEpochs.begin(), mBucketEpochs.end(), 0);
+		mLatestEpoch = 0;
+	}
+
+	// writes the state of the window, the random generator and all the buckets to the end of buffer
+	// every bucket is written the same way as ReservoirSampler::serialize does, see reservoir_sampler_serialization.h
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	void serialize(std::vector<std::byte>& buffer, const Codec& codec = Codec()) const
+	{
+		ReservoirSamplerUtils::BinaryWriter writer(buffer);
+		ReservoirSamplerUtils::writeHeader(writer, ReservoirSamplerUtils::SerializedSamplerType::Windowed, mSamplesCount);
+		writer.write(mBuckets.size());
+		writer.write(mBucketDuration);
+		ReservoirSamplerUtils::writeRand(writer, mRand);
+		writer.write(mLatestEpoch);
+		for (size_t i = 0; i < mBuckets.size(); ++i)
+		{
+			writer.write(mBucketEpochs[i]);
+			writer.writeNested([this, i, &codec](std::vector<std::byte>& bucketBuffer) { mBuckets[i].serialize(bucketBuffer, codec); });
+		}
+	}
+
+	// restores the state written by serialize, the sampler should have the same samples count, buckets count and bucket duration
+	// returns false if the data can't be read, in this case the sampler is left in the reset state
+	template<typename Codec = ReservoirSamplerUtils::TrivialCodec<T>>
+	bool deserialize(const std::byte* data, size_t size, const Codec& codec = Codec())
+	{
+		reset();
+
+		ReservoirSamplerUtils::BinaryReader reader(data, size);
+		size_t bucketsCount = 0;
+		TimeType bucketDuration {};
+		size_t latestEpoch = 0;
+		if (!ReservoirSamplerUtils::readHeader(reader, ReservoirSamplerUtils::SerializedSamplerType::Windowed, mSamplesCount)
+			|| !reader.read(bucketsCount)
+			|| bucketsCount != mBuckets.size()
+			|| !reader.read(bucketDuration)
+			|| bucketDuration != mBucketDuration
+			|| !ReservoirSamplerUtils::readRand(reader, mRand)
+			|| !reader.read(latestEpoch))
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < mBuckets.size(); ++i)
+		{
+			if (!reader.read(mBucketEpochs[i])
+				|| !reader.readNested([this, i, &codec](const std::byte* bucketData, size_t bucketSize) { return mBuckets[i].deserialize(bucketData, bucketSize, codec); }))
+			{
+				reset();
+				return false;
+			}
+		}
+		mLatestEpoch = latestEpoch;
+		return true;
+	}
+
+	// the stats of all the buckets together, the buckets keep their stats when they are reused
+	StatsPolicy getStats() const
+	{
+		StatsPolicy result = mBuckets[0].getStats();
+		for (size_t i = 1; i < mBuckets.size(); ++i)
+		{
+			result.merge(mBuckets[i].getStats());
+		}
+		return result;
+	}
+
+private:
+	size_t getEpoch(TimeType time) const
+	{
+		assert(time >= TimeType{});
+		return static_cast<size_t>(time / mBucketDuration);
+	}
+
+	bool isEpochInWindow(size_t epoch, size_t currentEpoch) const
+	{
+		return epoch <= currentEpoch && currentEpoch - epoch < mBuckets.size();
+	}
+
+	// returns nullptr if the time is already out of the window
+	Sampler* getBucket(TimeType time)
+	{
+		const size_t epoch = getEpoch(time);
+		if (epoch > mLatestEpoch)
+		{
+			mLatestEpoch = epoch;
+		}
+		else if (!isEpochInWindow(epoch, mLatestEpoch))
+		{
+			return nullptr;
+		}
+
+		// the index of a bucket is its epoch modulo the buckets count, so a different epoch in the slot means it has expired
+		const size_t index = epoch % mBuckets.size();
+		if (mBucketEpochs[index] != epoch)
+		{
+			mBuckets[index].reset();
+			mBucketEpochs[index] = epoch;
+		}
+		return &mBuckets[index];
+	}
+
+	URNG makeRand()
+	{
+		return URNG(static_cast<typename URNG::result_type>(mRand()));
+	}
+
+private:
+	const size_t mSamplesCount;
+	const TimeType mBucketDuration;
+	URNG mRand;
+	std::vector<Sampler> mBuckets;
+	std::vector<size_t> mBucketEpochs;
+	size_t mLatestEpoch = 0;
+};
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_async.h"
+#include "reservoir_sampler_weighted.h"
+
+TEST(ReservoirSamplerAsync, SamplesWithSeparateProducerAndConsumer)
+{
+	constexpr int ElementsCount = 200000;
+	ReservoirSamplerAsync<int> sampler{20, 256, std::mt19937{1}};
+
+	std::atomic<bool> isProducerDone{false};
+	std::thread consumer([&sampler, &isProducerDone] {
+		while (!isProducerDone.load(std::memory_order_acquire) || sampler.getQueuedCount() > 0)
+		{
+			if (sampler.processQueued() == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+	for (int i = 0; i < ElementsCount; ++i)
+	{
+		sampler.sampleElement(static_cast<float>(i % 10 + 1), i);
+	}
+	isProducerDone.store(true, std::memory_order_release);
+	consumer.join();
+
+	ASSERT_EQ(sampler.getResultSize(), 20u);
+	std::vector<int> result(sampler.getResult().begin(), sampler.getResult().end());
+	std::sort(result.begin(), result.end());
+	EXPECT_EQ(std::adjacent_find(result.begin(), result.end()), result.end());
+	EXPECT_GE(result.front(), 0);
+	EXPECT_LT(result.back(), ElementsCount);
+}
+
+TEST(ReservoirSamplerAsync, DistributionMatchesReservoirSamplerWeighted)
+{
+	constexpr size_t RepeatsCount = 20000;
+	std::array<size_t, 10> asyncCounts{};
+	std::array<size_t, 10> directCounts{};
+	for (size_t repeat = 0; repeat < RepeatsCount; ++repeat)
+	{
+		ReservoirSamplerAsync<int> async{5, 64, std::mt19937{static_cast<uint32_t>(repeat)}};
+		ReservoirSamplerWeighted<int> direct{5, std::mt19937{static_cast<uint32_t>(repeat + RepeatsCount)}};
+		for (int i = 0; i < 1000; ++i)
+		{
+			const int element = i % 10;
+			const float weight = static_cast<float>(element + 1);
+			if (!async.trySampleElement(weight, element))
+			{
+				async.processQueued();
+				ASSERT_TRUE(async.trySampleElement(weight, element));
+			}
+			direct.sampleElement(weight, element);
+			// the consumer lags behind the producer, as it would on another thread
+			if (i % 37 == 0)
+			{
+				async.processQueued();
+			}
+		}
+		async.processQueued();
+
+		ASSERT_EQ(async.getResultSize(), 5u);
+		for (int element : async.getResult())
+		{
+			++asyncCounts[element];
+		}
+		for (int element : direct.getResult())
+		{
+			++directCounts[element];
+		}
+	}
+
+	for (size_t i = 0; i < asyncCounts.size(); ++i)
+	{
+		EXPECT_NEAR(static_cast<double>(asyncCounts[i]), static_cast<double>(directCounts[i]), directCounts[i] * 0.1);
+	}
+}
+
+TEST(ReservoirSamplerAsync, ResetDropsQueuedElements)
+{
+	ReservoirSamplerAsync<int> sampler{5, 16, std::mt19937{1}};
+	for (int i = 0; i < 10; ++i)
+	{
+		ASSERT_TRUE(sampler.trySampleElement(1.0f, i));
+	}
+	EXPECT_EQ(sampler.getQueuedCount(), 10u);
+	EXPECT_EQ(sampler.getResultSize(), 0u);
+
+	sampler.reset();
+	EXPECT_EQ(sampler.getQueuedCount(), 0u);
+	EXPECT_EQ(sampler.processQueued(), 0u);
+	EXPECT_EQ(sampler.getResultSize(), 0u);
+}
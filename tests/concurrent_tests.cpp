@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_concurrent.h"
+
+TEST(ReservoirSamplerConcurrent, SamplesFromMultipleThreads)
+{
+	constexpr size_t ThreadsCount = 4;
+	constexpr int ElementsPerThread = 100000;
+	ReservoirSamplerConcurrent<int> sampler{100, std::mt19937{1}};
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < ThreadsCount; ++t)
+	{
+		threads.emplace_back([&sampler, t] {
+			for (int i = 0; i < ElementsPerThread; ++i)
+			{
+				sampler.sampleElement(static_cast<int>(t)*ElementsPerThread + i);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(sampler.getSeenElementsCount(), ThreadsCount*ElementsPerThread);
+	ASSERT_EQ(sampler.getResultSize(), 100u);
+	std::vector<int> result(sampler.getResult().begin(), sampler.getResult().end());
+	std::sort(result.begin(), result.end());
+	EXPECT_EQ(std::adjacent_find(result.begin(), result.end()), result.end());
+	EXPECT_GE(result.front(), 0);
+	EXPECT_LT(result.back(), static_cast<int>(ThreadsCount)*ElementsPerThread);
+}
+
+TEST(ReservoirSamplerConcurrent, KeepsAllElementsOfShortStream)
+{
+	ReservoirSamplerConcurrent<int> sampler{100, std::mt19937{1}};
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&sampler, t] {
+			for (int i = 0; i < 10; ++i)
+			{
+				sampler.sampleElement(t*10 + i);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	std::vector<int> result = sampler.consumeResult();
+	std::sort(result.begin(), result.end());
+	ASSERT_EQ(result.size(), 40u);
+	for (int i = 0; i < 40; ++i)
+	{
+		EXPECT_EQ(result[i], i);
+	}
+	EXPECT_EQ(sampler.getSeenElementsCount(), 0u);
+}
@@ -0,0 +1,152 @@
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_heavy_hitters.h"
+
+namespace
+{
+	// uniform noise over 1000 values with a quarter of the elements being one of 5 frequent values
+	std::vector<int> generateStream(size_t size)
+	{
+		std::mt19937 rand(1);
+		std::vector<int> stream;
+		stream.reserve(size);
+		for (size_t i = 0; i < size; ++i)
+		{
+			const int value = static_cast<int>(rand() % 1000);
+			stream.push_back(rand() % 4 == 0 ? static_cast<int>(rand() % 5) : value);
+		}
+		return stream;
+	}
+
+	std::map<int, uint64_t> countExactly(const std::vector<int>& stream)
+	{
+		std::map<int, uint64_t> counts;
+		for (int value : stream)
+		{
+			++counts[value];
+		}
+		return counts;
+	}
+
+	template<typename Sampler>
+	void checkSpaceSavingBounds(const Sampler& sampler, const std::map<int, uint64_t>& exactCounts, size_t elementsCount, size_t heavyHittersCount)
+	{
+		const auto heavyHitters = sampler.getHeavyHitters();
+		EXPECT_LE(heavyHitters.size(), heavyHittersCount);
+
+		// the counts are upper bounds and the counts without the errors are lower bounds
+		for (const auto& heavyHitter : heavyHitters)
+		{
+			const uint64_t exactCount = exactCounts.at(heavyHitter.element);
+			EXPECT_GE(heavyHitter.count, exactCount);
+			EXPECT_LE(heavyHitter.count - heavyHitter.error, exactCount);
+		}
+
+		// every element that is more frequent than elementsCount/heavyHittersCount is tracked
+		for (const auto& [element, exactCount] : exactCounts)
+		{
+			if (exactCount > elementsCount / heavyHittersCount)
+			{
+				bool isFound = false;
+				for (const auto& heavyHitter : heavyHitters)
+				{
+					isFound |= heavyHitter.element == element;
+				}
+				EXPECT_TRUE(isFound) << "element " << element;
+			}
+			EXPECT_GE(sampler.getCountEstimate(element), exactCount);
+		}
+	}
+}
+
+TEST(ReservoirSamplerHeavyHitters, KeepsSpaceSavingBounds)
+{
+	const std::vector<int> stream = generateStream(200000);
+	const std::map<int, uint64_t> exactCounts = countExactly(stream);
+
+	ReservoirSamplerHeavyHitters<int> sampler{100, 50, std::mt19937{2}};
+	for (int value : stream)
+	{
+		sampler.sampleElement(value);
+	}
+
+	EXPECT_EQ(sampler.getResult().size, 100u);
+	EXPECT_EQ(sampler.getSeenElementsCount(), stream.size());
+	checkSpaceSavingBounds(sampler, exactCounts, stream.size(), 50);
+}
+
+TEST(ReservoirSamplerHeavyHitters, MergedCountersKeepSpaceSavingBounds)
+{
+	const std::vector<int> stream = generateStream(200000);
+	const std::map<int, uint64_t> exactCounts = countExactly(stream);
+
+	ReservoirSamplerHeavyHitters<int> first{100, 50, std::mt19937{3}};
+	ReservoirSamplerHeavyHitters<int> second{100, 50, std::mt19937{4}};
+	for (size_t i = 0; i < stream.size(); ++i)
+	{
+		(i % 2 == 0 ? first : second).sampleElement(stream[i]);
+	}
+	first.merge(second);
+
+	EXPECT_EQ(first.getSeenElementsCount(), stream.size());
+	checkSpaceSavingBounds(first, exactCounts, stream.size(), 50);
+}
+
+TEST(ReservoirSamplerHeavyHitters, CountsExactlyWhileTableIsNotFull)
+{
+	ReservoirSamplerHeavyHitters<std::string> sampler{3, 4, std::mt19937{1}};
+	for (const char* word : {"a", "b", "a", "c", "a", "b"})
+	{
+		sampler.sampleElement(std::string(word));
+	}
+
+	const auto heavyHitters = sampler.getHeavyHitters();
+	ASSERT_EQ(heavyHitters.size(), 3u);
+	EXPECT_EQ(heavyHitters[0].element, "a");
+	EXPECT_EQ(heavyHitters[0].count, 3u);
+	EXPECT_EQ(heavyHitters[1].element, "b");
+	EXPECT_EQ(heavyHitters[1].count, 2u);
+	for (const auto& heavyHitter : heavyHitters)
+	{
+		EXPECT_EQ(heavyHitter.error, 0u);
+	}
+	EXPECT_EQ(sampler.getCountEstimate("d"), 0u);
+}
+
+TEST(ReservoirSamplerHeavyHitters, ReplacesTheSmallestCounter)
+{
+	ReservoirSamplerHeavyHitters<std::string> sampler{3, 2, std::mt19937{1}};
+	for (const char* word : {"a", "a", "b", "c"})
+	{
+		sampler.sampleElement(std::string(word));
+	}
+
+	// "c" takes the counter of "b" together with its count as the error
+	const auto heavyHitters = sampler.getHeavyHitters();
+	ASSERT_EQ(heavyHitters.size(), 2u);
+	EXPECT_EQ(heavyHitters[0].element, "a");
+	EXPECT_EQ(heavyHitters[0].count, 2u);
+	EXPECT_EQ(heavyHitters[1].element, "c");
+	EXPECT_EQ(heavyHitters[1].count, 2u);
+	EXPECT_EQ(heavyHitters[1].error, 1u);
+}
+
+TEST(ReservoirSamplerHeavyHitters, ResetClearsCounters)
+{
+	ReservoirSamplerHeavyHitters<int> sampler{3, 2, std::mt19937{1}};
+	for (int i = 0; i < 10; ++i)
+	{
+		sampler.sampleElement(i % 3);
+	}
+	sampler.reset();
+
+	EXPECT_TRUE(sampler.getHeavyHitters().empty());
+	EXPECT_EQ(sampler.getSeenElementsCount(), 0u);
+	EXPECT_EQ(sampler.getCountEstimate(0), 0u);
+}
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <array>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_indexed.h"
+
+TEST(ReservoirSamplerIndexed, SelectsDistinctElementsWithPositiveWeights)
+{
+	ReservoirSamplerIndexed<int> sampler{5, {0, 1, 2, 3, 4, 5, 6, 7}, {1.0f, 0.0f, 2.0f, 0.0f, 3.0f, 1.0f, 0.0f, 5.0f}, std::mt19937{1}};
+	for (int repeat = 0; repeat < 100; ++repeat)
+	{
+		sampler.sample();
+		const std::vector<size_t>& indexes = sampler.getResultIndexes();
+		ASSERT_EQ(indexes.size(), 5u);
+		EXPECT_EQ(std::set<size_t>(indexes.begin(), indexes.end()).size(), indexes.size());
+		for (size_t index : indexes)
+		{
+			EXPECT_GT(sampler.getWeight(index), 0.0f);
+			EXPECT_EQ(static_cast<size_t>(sampler.getElement(index)), index);
+		}
+	}
+}
+
+TEST(ReservoirSamplerIndexed, SelectsOnlyPositiveWeightsWhenThereAreNotEnoughOfThem)
+{
+	ReservoirSamplerIndexed<int> sampler{5, {0, 1, 2, 3}, {1.0f, 0.0f, 2.0f, 0.0f}, std::mt19937{1}};
+	sampler.sample();
+	std::vector<size_t> indexes = sampler.getResultIndexes();
+	std::sort(indexes.begin(), indexes.end());
+	EXPECT_EQ(indexes, (std::vector<size_t>{0, 2}));
+	EXPECT_EQ(sampler.getResultSize(), 2u);
+}
+
+TEST(ReservoirSamplerIndexed, TerminatesWithWeightsOfDifferentMagnitudes)
+{
+	// removing huge weights from the tree leaves residue that is bigger than the small weights
+	std::vector<int> elements;
+	std::vector<double> weights;
+	size_t positiveWeightsCount = 0;
+	for (int i = 0; i < 1000; ++i)
+	{
+		elements.push_back(i);
+		const double weight = (i % 3 == 0) ? 1e18 : ((i % 3 == 1) ? 1e-3 : 0.0);
+		weights.push_back(weight);
+		positiveWeightsCount += weight > 0 ? 1 : 0;
+	}
+
+	ReservoirSamplerIndexed<int, double> sampler{800, elements, weights, std::mt19937{1}};
+	for (int repeat = 0; repeat < 20; ++repeat)
+	{
+		sampler.sample();
+		const std::vector<size_t>& indexes = sampler.getResultIndexes();
+		ASSERT_EQ(indexes.size(), positiveWeightsCount);
+		EXPECT_EQ(std::set<size_t>(indexes.begin(), indexes.end()).size(), indexes.size());
+		for (size_t index : indexes)
+		{
+			EXPECT_GT(weights[index], 0.0);
+		}
+	}
+}
+
+TEST(ReservoirSamplerIndexed, SetWeightChangesTheSelectableElements)
+{
+	ReservoirSamplerIndexed<int> sampler{2, {0, 1, 2}, {1.0f, 1.0f, 1.0f}, std::mt19937{1}};
+	sampler.setWeight(1, 0.0f);
+	sampler.sample();
+	std::vector<size_t> indexes = sampler.getResultIndexes();
+	std::sort(indexes.begin(), indexes.end());
+	EXPECT_EQ(indexes, (std::vector<size_t>{0, 2}));
+
+	sampler.setWeight(0, 0.0f);
+	sampler.setWeight(2, 0.0f);
+	sampler.sample();
+	EXPECT_TRUE(sampler.getResultIndexes().empty());
+}
+
+TEST(ReservoirSamplerIndexed, InclusionMatchesSequentialWeightedSampling)
+{
+	// with k = 2 out of weights {1, 2, 3, 4} the inclusion probability of i is
+	// w_i/W + sum over j != i of w_j/W * w_i/(W - w_j)
+	const std::array<double, 4> weights = {1.0, 2.0, 3.0, 4.0};
+	const double totalWeight = 10.0;
+	std::array<double, 4> expected{};
+	for (size_t i = 0; i < weights.size(); ++i)
+	{
+		expected[i] = weights[i] / totalWeight;
+		for (size_t j = 0; j < weights.size(); ++j)
+		{
+			if (j != i)
+			{
+				expected[i] += weights[j] / totalWeight * weights[i] / (totalWeight - weights[j]);
+			}
+		}
+	}
+
+	constexpr size_t RepeatsCount = 100000;
+	ReservoirSamplerIndexed<int> sampler{2, {0, 1, 2, 3}, {1.0f, 2.0f, 3.0f, 4.0f}, std::mt19937{2}};
+	std::array<size_t, 4> counts{};
+	for (size_t repeat = 0; repeat < RepeatsCount; ++repeat)
+	{
+		sampler.sample();
+		for (size_t index : sampler.getResultIndexes())
+		{
+			++counts[index];
+		}
+	}
+
+	for (size_t i = 0; i < counts.size(); ++i)
+	{
+		EXPECT_NEAR(static_cast<double>(counts[i]) / RepeatsCount, expected[i], 0.01);
+	}
+}
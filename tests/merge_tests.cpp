@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler.h"
+#include "reservoir_sampler_weighted.h"
+
+namespace
+{
+	constexpr size_t RepeatsCount = 20000;
+}
+
+TEST(ReservoirSamplerMerge, KeepsSamplesCountAndSumsSeenElements)
+{
+	ReservoirSampler<int> first{10, std::mt19937{1}};
+	ReservoirSampler<int> second{10, std::mt19937{2}};
+	for (int i = 0; i < 100; ++i)
+	{
+		first.sampleElement(i);
+	}
+	for (int i = 100; i < 1000; ++i)
+	{
+		second.sampleElement(i);
+	}
+
+	first.merge(second);
+
+	EXPECT_EQ(first.getResultSize(), 10u);
+	EXPECT_EQ(first.getSeenElementsCount(), 1000u);
+	std::vector<int> result(first.getResult().begin(), first.getResult().end());
+	std::sort(result.begin(), result.end());
+	EXPECT_EQ(std::adjacent_find(result.begin(), result.end()), result.end());
+}
+
+TEST(ReservoirSamplerMerge, TakesAllElementsOfNotFilledSamplers)
+{
+	ReservoirSampler<std::string> first{10, std::mt19937{1}};
+	ReservoirSampler<std::string> second{10, std::mt19937{2}};
+	for (int i = 0; i < 3; ++i)
+	{
+		first.sampleElement(std::to_string(i));
+	}
+	for (int i = 3; i < 7; ++i)
+	{
+		second.sampleElement(std::to_string(i));
+	}
+
+	first.merge(second);
+
+	std::vector<std::string> result(first.getResult().begin(), first.getResult().end());
+	std::sort(result.begin(), result.end());
+	EXPECT_EQ(result, (std::vector<std::string>{"0", "1", "2", "3", "4", "5", "6"}));
+}
+
+TEST(ReservoirSamplerMerge, MergingEmptySamplerKeepsTheResult)
+{
+	ReservoirSampler<int> first{5, std::mt19937{1}};
+	ReservoirSampler<int> second{5, std::mt19937{2}};
+	for (int i = 0; i < 100; ++i)
+	{
+		first.sampleElement(i);
+	}
+	const std::vector<int> resultBefore(first.getResult().begin(), first.getResult().end());
+
+	first.merge(second);
+
+	EXPECT_EQ(std::vector<int>(first.getResult().begin(), first.getResult().end()), resultBefore);
+	EXPECT_EQ(first.getSeenElementsCount(), 100u);
+}
+
+TEST(ReservoirSamplerMerge, ResultIsUniformOverBothStreams)
+{
+	// the streams have different lengths, and the sampling continues after the merge
+	std::array<size_t, 10> buckets{};
+	for (size_t repeat = 0; repeat < RepeatsCount; ++repeat)
+	{
+		ReservoirSampler<int> first{10, std::mt19937{static_cast<uint32_t>(repeat)}};
+		ReservoirSampler<int> second{10, std::mt19937{static_cast<uint32_t>(repeat + RepeatsCount)}};
+		for (int i = 0; i < 100; ++i)
+		{
+			first.sampleElement(i);
+		}
+		for (int i = 100; i < 1000; ++i)
+		{
+			second.sampleElement(i);
+		}
+		first.merge(second);
+		for (int i = 1000; i < 2000; ++i)
+		{
+			first.sampleElement(i);
+		}
+
+		ASSERT_EQ(first.getResultSize(), 10u);
+		for (int element : first.getResult())
+		{
+			++buckets[element / 200];
+		}
+	}
+
+	const double expected = static_cast<double>(RepeatsCount) * 10 / buckets.size();
+	for (size_t count : buckets)
+	{
+		EXPECT_NEAR(static_cast<double>(count), expected, expected * 0.05);
+	}
+}
+
+TEST(ReservoirSamplerWeightedMerge, ResultMatchesSamplingOneStream)
+{
+	std::array<size_t, 10> mergedCounts{};
+	std::array<size_t, 10> singleCounts{};
+	for (size_t repeat = 0; repeat < RepeatsCount; ++repeat)
+	{
+		ReservoirSamplerWeighted<int> first{5, std::mt19937{static_cast<uint32_t>(repeat)}};
+		ReservoirSamplerWeighted<int> second{5, std::mt19937{static_cast<uint32_t>(repeat + RepeatsCount)}};
+		ReservoirSamplerWeighted<int> single{5, std::mt19937{static_cast<uint32_t>(repeat + 2*RepeatsCount)}};
+		for (int i = 0; i < 1000; ++i)
+		{
+			const int element = i % 10;
+			const float weight = static_cast<float>(element + 1);
+			(i < 300 ? first : second).sampleElement(weight, element);
+			single.sampleElement(weight, element);
+		}
+		first.merge(second);
+
+		ASSERT_EQ(first.getResultSize(), 5u);
+		for (int element : first.getResult())
+		{
+			++mergedCounts[element];
+		}
+		for (int element : single.getResult())
+		{
+			++singleCounts[element];
+		}
+	}
+
+	for (size_t i = 0; i < mergedCounts.size(); ++i)
+	{
+		EXPECT_NEAR(static_cast<double>(mergedCounts[i]), static_cast<double>(singleCounts[i]), singleCounts[i] * 0.1);
+	}
+}
@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <execution>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_parallel.h"
+#include "reservoir_sampler_random.h"
+
+using ReservoirSamplerUtils::Philox4x32;
+
+namespace
+{
+	// the counter of a block is {blockIndex, stream}, so the 128-bit counters of the known answers are split this way
+	std::vector<uint32_t> generateBlock(uint64_t key, uint64_t stream, uint64_t blockIndex)
+	{
+		uint32_t values[4];
+		Philox4x32(key, stream).generateBlock(blockIndex, values);
+		return std::vector<uint32_t>(values, values + 4);
+	}
+}
+
+// known answers of philox4x32-10 from the Random123 library
+TEST(Philox4x32, MatchesKnownAnswers)
+{
+	EXPECT_EQ(generateBlock(0, 0, 0), (std::vector<uint32_t>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+	EXPECT_EQ(generateBlock(0xffffffffffffffffULL, 0xffffffffffffffffULL, 0xffffffffffffffffULL), (std::vector<uint32_t>{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+	EXPECT_EQ(generateBlock(0x299f31d0a4093822ULL, 0x0370734413198a2eULL, 0x85a308d3243f6a88ULL), (std::vector<uint32_t>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+}
+
+TEST(Philox4x32, OutputsBlocksInOrder)
+{
+	Philox4x32 rand(42, 7);
+	for (uint64_t blockIndex = 0; blockIndex < 3; ++blockIndex)
+	{
+		const std::vector<uint32_t> block = generateBlock(42, 7, blockIndex);
+		for (uint32_t value : block)
+		{
+			EXPECT_EQ(rand(), value);
+		}
+	}
+}
+
+TEST(Philox4x32, DiscardMatchesGeneratingValues)
+{
+	for (uint64_t count : {0, 1, 3, 4, 5, 7, 100})
+	{
+		Philox4x32 generated(5);
+		Philox4x32 discarded(5);
+		// start not at the beginning of a block
+		generated();
+		discarded();
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			generated();
+		}
+		discarded.discard(count);
+		EXPECT_EQ(generated(), discarded()) << "count " << count;
+	}
+}
+
+TEST(Philox4x32, SplitDependsOnlyOnTheStateAndIndex)
+{
+	Philox4x32 first(5);
+	Philox4x32 second(5);
+	// the position in the parent stream doesn't affect the substreams
+	second.discard(10);
+
+	Philox4x32 firstSplit = first.split(3);
+	Philox4x32 secondSplit = second.split(3);
+	Philox4x32 otherSplit = first.split(4);
+	const uint32_t firstValue = firstSplit();
+	EXPECT_EQ(firstValue, secondSplit());
+	EXPECT_NE(firstValue, otherSplit());
+
+	static_assert(ReservoirSamplerUtils::IsSplittable<Philox4x32>::value);
+	static_assert(!ReservoirSamplerUtils::IsSplittable<std::mt19937>::value);
+}
+
+TEST(Philox4x32, ParallelSamplingIsReproducible)
+{
+	std::vector<int> elements(1 << 20);
+	std::iota(elements.begin(), elements.end(), 0);
+
+	Philox4x32 firstRand(9);
+	Philox4x32 secondRand(9);
+	const std::vector<int> firstResult = ReservoirSamplerUtils::parallelSample(std::execution::seq, elements.begin(), elements.end(), 100, firstRand);
+	const std::vector<int> secondResult = ReservoirSamplerUtils::parallelSample(std::execution::seq, elements.begin(), elements.end(), 100, secondRand);
+
+	EXPECT_EQ(firstResult.size(), 100u);
+	EXPECT_EQ(firstResult, secondResult);
+	// the next call continues the generator and gets different substreams
+	EXPECT_NE(ReservoirSamplerUtils::parallelSample(std::execution::seq, elements.begin(), elements.end(), 100, firstRand), firstResult);
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <array>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_pool.h"
+#include "reservoir_sampler_stratified.h"
+#include "reservoir_sampler_weighted.h"
+
+namespace
+{
+	constexpr size_t RepeatsCount = 20000;
+}
+
+TEST(ReservoirSamplerPool, SamplesGroupsIndependently)
+{
+	ReservoirSamplerPool<int> pool{std::vector<size_t>{2, 5, 10}, std::mt19937{1}};
+	for (int i = 0; i < 1000; ++i)
+	{
+		pool.sampleElement(static_cast<size_t>(i % 3), i);
+	}
+
+	for (size_t group = 0; group < pool.getGroupsCount(); ++group)
+	{
+		ASSERT_EQ(pool.getResultSize(group), pool.getSamplesCount(group));
+		std::vector<int> result(pool.getResult(group).begin(), pool.getResult(group).end());
+		std::sort(result.begin(), result.end());
+		EXPECT_EQ(std::adjacent_find(result.begin(), result.end()), result.end());
+		for (int element : result)
+		{
+			EXPECT_EQ(static_cast<size_t>(element % 3), group);
+		}
+	}
+}
+
+TEST(ReservoirSamplerPool, GroupResultIsUniform)
+{
+	std::array<size_t, 10> buckets{};
+	ReservoirSamplerPool<int> pool{2, 5, std::mt19937{1}};
+	for (size_t repeat = 0; repeat < RepeatsCount; ++repeat)
+	{
+		for (int i = 0; i < 100; ++i)
+		{
+			pool.sampleElement(1, i);
+			// the other group shares the random generator
+			pool.sampleElement(0, i);
+		}
+		for (int element : pool.consumeResult(1))
+		{
+			++buckets[element / 10];
+		}
+		pool.reset(0);
+	}
+
+	const double expected = static_cast<double>(RepeatsCount) * 5 / buckets.size();
+	for (size_t count : buckets)
+	{
+		EXPECT_NEAR(static_cast<double>(count), expected, expected * 0.05);
+	}
+}
+
+TEST(ReservoirSamplerPool, MovedFromPoolIsEmpty)
+{
+	ReservoirSamplerPool<int> pool{3, 4, std::mt19937{1}};
+	for (int i = 0; i < 100; ++i)
+	{
+		pool.sampleElement(static_cast<size_t>(i % 3), i);
+	}
+
+	ReservoirSamplerPool<int> moved(std::move(pool));
+	EXPECT_EQ(moved.getGroupsCount(), 3u);
+	EXPECT_EQ(moved.getResultSize(2), 4u);
+	EXPECT_EQ(pool.getGroupsCount(), 0u);
+	pool.reset();
+}
+
+TEST(ReservoirSamplerStratified, UniformAndWeightedStrataAreSampledSeparately)
+{
+	std::array<size_t, 10> weightedCounts{};
+	std::array<size_t, 10> referenceCounts{};
+	for (size_t repeat = 0; repeat < RepeatsCount; ++repeat)
+	{
+		ReservoirSamplerStratified<int> stratified{std::vector<size_t>{3, 5}, std::mt19937{static_cast<uint32_t>(repeat)}};
+		ReservoirSamplerWeighted<int> reference{5, std::mt19937{static_cast<uint32_t>(repeat + RepeatsCount)}};
+		for (int i = 0; i < 1000; ++i)
+		{
+			const int element = i % 10;
+			const float weight = static_cast<float>(element + 1);
+			stratified.sampleElement(0, element);
+			stratified.sampleWeightedElement(1, weight, element);
+			reference.sampleElement(weight, element);
+		}
+
+		ASSERT_EQ(stratified.getResultSize(0), 3u);
+		ASSERT_EQ(stratified.getResultSize(1), 5u);
+		for (int element : stratified.getResult(1))
+		{
+			++weightedCounts[element];
+		}
+		for (int element : reference.getResult())
+		{
+			++referenceCounts[element];
+		}
+	}
+
+	for (size_t i = 0; i < weightedCounts.size(); ++i)
+	{
+		EXPECT_NEAR(static_cast<double>(weightedCounts[i]), static_cast<double>(referenceCounts[i]), referenceCounts[i] * 0.1);
+	}
+}
+
+TEST(ReservoirSamplerStratified, BatchSamplesEveryStratum)
+{
+	constexpr size_t Count = 3000;
+	std::vector<size_t> strata(Count);
+	std::vector<int> elements(Count);
+	std::vector<float> weights(Count);
+	for (size_t i = 0; i < Count; ++i)
+	{
+		strata[i] = i % 3;
+		elements[i] = static_cast<int>(i);
+		weights[i] = static_cast<float>(i % 7 + 1);
+	}
+
+	ReservoirSamplerStratified<int> uniform{std::vector<size_t>{4, 4, 4}, std::mt19937{1}};
+	uniform.sampleBatch(strata.data(), elements.data(), Count);
+	ReservoirSamplerStratified<int> weighted{std::vector<size_t>{4, 4, 4}, std::mt19937{1}};
+	weighted.sampleWeightedBatch(strata.data(), weights.data(), elements.data(), Count);
+
+	for (const auto* sampler : {&uniform, &weighted})
+	{
+		for (size_t stratum = 0; stratum < sampler->getStrataCount(); ++stratum)
+		{
+			ASSERT_EQ(sampler->getResultSize(stratum), 4u);
+			for (int element : sampler->getResult(stratum))
+			{
+				EXPECT_EQ(static_cast<size_t>(element) % 3, stratum);
+			}
+		}
+	}
+}
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler.h"
+#include "reservoir_sampler_distinct.h"
+#include "reservoir_sampler_linear.h"
+#include "reservoir_sampler_pool.h"
+#include "reservoir_sampler_serialization.h"
+#include "reservoir_sampler_sharded.h"
+#include "reservoir_sampler_static.h"
+#include "reservoir_sampler_stratified.h"
+#include "reservoir_sampler_weighted.h"
+#include "reservoir_sampler_weighted_static.h"
+#include "reservoir_sampler_windowed.h"
+
+namespace
+{
+	struct StringCodec
+	{
+		void write(ReservoirSamplerUtils::BinaryWriter& writer, const std::string& string) const
+		{
+			writer.write(string.size());
+			writer.writeBytes(string.data(), string.size());
+		}
+
+		std::optional<std::string> read(ReservoirSamplerUtils::BinaryReader& reader) const
+		{
+			size_t size = 0;
+			if (!reader.read(size) || reader.getRemainingSize() < size)
+			{
+				return std::nullopt;
+			}
+			std::string string(size, '\0');
+			reader.readBytes(string.data(), size);
+			return string;
+		}
+	};
+
+	template<typename Sampler>
+	std::vector<int> getResultVector(const Sampler& sampler)
+	{
+		return std::vector<int>(sampler.getResult().begin(), sampler.getResult().end());
+	}
+
+	// the restored sampler should continue exactly the same way as the original one
+	template<typename Sampler, typename SampleFn>
+	void checkRoundTrip(Sampler& original, Sampler& restored, SampleFn sample)
+	{
+		for (int i = 0; i < 5000; ++i)
+		{
+			sample(original, i);
+		}
+
+		std::vector<std::byte> buffer;
+		original.serialize(buffer);
+		ASSERT_TRUE(restored.deserialize(buffer.data(), buffer.size()));
+		EXPECT_EQ(getResultVector(restored), getResultVector(original));
+
+		for (int i = 5000; i < 20000; ++i)
+		{
+			sample(original, i);
+			sample(restored, i);
+		}
+		EXPECT_EQ(getResultVector(restored), getResultVector(original));
+	}
+
+	// the same as checkRoundTrip for the samplers that return the result by value
+	template<typename Sampler, typename SampleFn, typename ResultFn>
+	void checkRoundTripByResult(Sampler& original, Sampler& restored, SampleFn sample, ResultFn getResult)
+	{
+		for (int i = 0; i < 5000; ++i)
+		{
+			sample(original, i);
+		}
+
+		std::vector<std::byte> buffer;
+		original.serialize(buffer);
+		ASSERT_TRUE(restored.deserialize(buffer.data(), buffer.size()));
+
+		for (int i = 5000; i < 20000; ++i)
+		{
+			sample(original, i);
+			sample(restored, i);
+		}
+		EXPECT_EQ(getResult(restored), getResult(original));
+	}
+
+	template<typename Pool>
+	std::vector<std::vector<int>> getGroupResults(const Pool& pool)
+	{
+		std::vector<std::vector<int>> result;
+		for (size_t group = 0; group < pool.getGroupsCount(); ++group)
+		{
+			result.emplace_back(pool.getResult(group).begin(), pool.getResult(group).end());
+		}
+		return result;
+	}
+}
+
+TEST(ReservoirSamplerSerialization, UniformRoundTrip)
+{
+	ReservoirSampler<int> original{10, std::mt19937{1}};
+	ReservoirSampler<int> restored{10, std::mt19937{2}};
+	checkRoundTrip(original, restored, [](auto& sampler, int i) { sampler.sampleElement(i); });
+}
+
+TEST(ReservoirSamplerSerialization, StaticRoundTrip)
+{
+	ReservoirSamplerStatic<int, 10> original{std::mt19937{1}};
+	ReservoirSamplerStatic<int, 10> restored{std::mt19937{2}};
+	checkRoundTrip(original, restored, [](auto& sampler, int i) { sampler.sampleElement(i); });
+}
+
+TEST(ReservoirSamplerSerialization, WeightedRoundTrip)
+{
+	ReservoirSamplerWeighted<int> original{10, std::mt19937{1}};
+	ReservoirSamplerWeighted<int> restored{10, std::mt19937{2}};
+	checkRoundTrip(original, restored, [](auto& sampler, int i) { sampler.sampleElement(static_cast<float>(i % 7 + 1), i); });
+}
+
+TEST(ReservoirSamplerSerialization, WeightedStaticRoundTrip)
+{
+	ReservoirSamplerWeightedStatic<int, 10> original{std::mt19937{1}};
+	ReservoirSamplerWeightedStatic<int, 10> restored{std::mt19937{2}};
+	checkRoundTrip(original, restored, [](auto& sampler, int i) { sampler.sampleElement(static_cast<float>(i % 7 + 1), i); });
+}
+
+TEST(ReservoirSamplerSerialization, LinearRoundTrip)
+{
+	ReservoirSamplerLinear<int> original{std::mt19937{1}};
+	ReservoirSamplerLinear<int> restored{std::mt19937{2}};
+	for (int i = 0; i < 5000; ++i)
+	{
+		original.sampleElement(1u, i);
+	}
+
+	std::vector<std::byte> buffer;
+	original.serialize(buffer);
+	ASSERT_TRUE(restored.deserialize(buffer.data(), buffer.size()));
+
+	for (int i = 5000; i < 20000; ++i)
+	{
+		original.sampleElement(1u, i);
+		restored.sampleElement(1u, i);
+	}
+	EXPECT_EQ(restored.getResult(), original.getResult());
+}
+
+TEST(ReservoirSamplerSerialization, CustomCodecRoundTrip)
+{
+	ReservoirSampler<std::string> original{10, std::mt19937{1}};
+	ReservoirSampler<std::string> restored{10, std::mt19937{2}};
+	for (int i = 0; i < 500; ++i)
+	{
+		original.sampleElement(std::to_string(i));
+	}
+
+	std::vector<std::byte> buffer;
+	original.serialize(buffer, StringCodec{});
+	ASSERT_TRUE(restored.deserialize(buffer.data(), buffer.size(), StringCodec{}));
+	EXPECT_EQ(std::vector<std::string>(restored.getResult().begin(), restored.getResult().end()),
+		std::vector<std::string>(original.getResult().begin(), original.getResult().end()));
+}
+
+TEST(ReservoirSamplerSerialization, RejectsTruncatedData)
+{
+	ReservoirSampler<int> original{10, std::mt19937{1}};
+	for (int i = 0; i < 100; ++i)
+	{
+		original.sampleElement(i);
+	}
+	std::vector<std::byte> buffer;
+	original.serialize(buffer);
+
+	ReservoirSampler<int> restored{10, std::mt19937{2}};
+	EXPECT_FALSE(restored.deserialize(buffer.data(), buffer.size() - 1));
+	EXPECT_EQ(restored.getResultSize(), 0u);
+}
+
+TEST(ReservoirSamplerSerialization, RejectsDifferentSamplesCount)
+{
+	ReservoirSampler<int> original{10, std::mt19937{1}};
+	for (int i = 0; i < 100; ++i)
+	{
+		original.sampleElement(i);
+	}
+	std::vector<std::byte> buffer;
+	original.serialize(buffer);
+
+	ReservoirSampler<int> restored{11, std::mt19937{2}};
+	EXPECT_FALSE(restored.deserialize(buffer.data(), buffer.size()));
+}
+
+TEST(ReservoirSamplerSerialization, PoolRoundTrip)
+{
+	ReservoirSamplerPool<int> original{std::vector<size_t>{3, 10, 5}, std::mt19937{1}};
+	ReservoirSamplerPool<int> restored{std::vector<size_t>{3, 10, 5}, std::mt19937{2}};
+	checkRoundTripByResult(original, restored,
+		[](auto& sampler, int i) { sampler.sampleElement(static_cast<size_t>(i % 3), i); },
+		[](const auto& sampler) { return getGroupResults(sampler); });
+}
+
+TEST(ReservoirSamplerSerialization, StratifiedRoundTrip)
+{
+	// the first stratum is sampled uniformly and the others with weights
+	ReservoirSamplerStratified<int> original{std::vector<size_t>{3, 10, 5}, std::mt19937{1}};
+	ReservoirSamplerStratified<int> restored{std::vector<size_t>{3, 10, 5}, std::mt19937{2}};
+	checkRoundTripByResult(original, restored,
+		[](auto& sampler, int i) {
+			const size_t stratum = static_cast<size_t>(i % 3);
+			if (stratum == 0)
+			{
+				sampler.sampleElement(stratum, i);
+			}
+			else
+			{
+				sampler.sampleWeightedElement(stratum, static_cast<float>(i % 7 + 1), i);
+			}
+		},
+		[](const auto& sampler) { return getGroupResults(sampler); });
+}
+
+TEST(ReservoirSamplerSerialization, WindowedRoundTrip)
+{
+	ReservoirSamplerWindowed<int> original{10, 4, 1000, std::mt19937{1}};
+	ReservoirSamplerWindowed<int> restored{10, 4, 1000, std::mt19937{2}};
+	checkRoundTripByResult(original, restored,
+		[](auto& sampler, int i) { sampler.sampleElement(static_cast<uint64_t>(i), i); },
+		[](auto& sampler) { return sampler.getResult(20000); });
+}
+
+TEST(ReservoirSamplerSerialization, DistinctRoundTrip)
+{
+	ReservoirSamplerDistinct<int> original{10};
+	ReservoirSamplerDistinct<int> restored{10};
+	checkRoundTripByResult(original, restored,
+		[](auto& sampler, int i) { sampler.sampleElement(i % 3000); },
+		[](const auto& sampler) { return std::make_pair(getResultVector(sampler), sampler.getDistinctCountEstimate()); });
+}
+
+TEST(ReservoirSamplerSerialization, ShardedRoundTrip)
+{
+	auto makeSampler = [](uint32_t seed) {
+		return ReservoirSamplerSharded<ReservoirSampler<int>>(3, [seed](size_t i) { return ReservoirSampler<int>(10, std::mt19937{seed + static_cast<uint32_t>(i)}); });
+	};
+	auto original = makeSampler(1);
+	auto restored = makeSampler(10);
+	checkRoundTripByResult(original, restored,
+		[](auto& sampler, int i) { sampler.sampleElement(static_cast<size_t>(i % 3), i); },
+		[](const auto& sampler) { return sampler.getResult(); });
+}
+
+TEST(ReservoirSamplerSerialization, ShardedWeightedRoundTrip)
+{
+	using Sampler = ReservoirSamplerWeighted<int>;
+	auto makeSampler = [](uint32_t seed) {
+		return ReservoirSamplerSharded<Sampler>(3, [seed](size_t i) { return Sampler(10, std::mt19937{seed + static_cast<uint32_t>(i)}); });
+	};
+	auto original = makeSampler(1);
+	auto restored = makeSampler(10);
+	checkRoundTripByResult(original, restored,
+		[](auto& sampler, int i) { sampler.sampleElement(static_cast<size_t>(i % 3), static_cast<float>(i % 7 + 1), i); },
+		[](const auto& sampler) {
+			// the restored heaps can have a different layout, so the merged elements can come in a different order
+			std::vector<int> result = sampler.getResult();
+			std::sort(result.begin(), result.end());
+			return result;
+		});
+}
+
+TEST(ReservoirSamplerSerialization, PoolRejectsDifferentGroups)
+{
+	ReservoirSamplerPool<int> original{std::vector<size_t>{3, 10}, std::mt19937{1}};
+	for (int i = 0; i < 100; ++i)
+	{
+		original.sampleElement(static_cast<size_t>(i % 2), i);
+	}
+	std::vector<std::byte> buffer;
+	original.serialize(buffer);
+
+	ReservoirSamplerPool<int> restored{std::vector<size_t>{10, 3}, std::mt19937{2}};
+	EXPECT_FALSE(restored.deserialize(buffer.data(), buffer.size()));
+	EXPECT_EQ(restored.getResultSize(0), 0u);
+	EXPECT_EQ(restored.getResultSize(1), 0u);
+}
+
+TEST(ReservoirSamplerSerialization, WindowedRejectsTruncatedData)
+{
+	ReservoirSamplerWindowed<int> original{10, 4, 1000, std::mt19937{1}};
+	for (int i = 0; i < 3000; ++i)
+	{
+		original.sampleElement(static_cast<uint64_t>(i), i);
+	}
+	std::vector<std::byte> buffer;
+	original.serialize(buffer);
+
+	ReservoirSamplerWindowed<int> restored{10, 4, 1000, std::mt19937{2}};
+	EXPECT_FALSE(restored.deserialize(buffer.data(), buffer.size() - 1));
+	EXPECT_TRUE(restored.getResult(3000).empty());
+}
+
+TEST(ReservoirSamplerSerialization, ShardedPassesCodecToShards)
+{
+	using Sampler = ReservoirSamplerSharded<ReservoirSampler<std::string>>;
+	Sampler original{2, [](size_t i) { return ReservoirSampler<std::string>(10, std::mt19937{static_cast<uint32_t>(i)}); }};
+	Sampler restored{2, [](size_t i) { return ReservoirSampler<std::string>(10, std::mt19937{static_cast<uint32_t>(i + 10)}); }};
+	for (int i = 0; i < 500; ++i)
+	{
+		original.sampleElement(static_cast<size_t>(i % 2), std::to_string(i));
+	}
+
+	std::vector<std::byte> buffer;
+	original.serialize(buffer, StringCodec{});
+	ASSERT_TRUE(restored.deserialize(buffer.data(), buffer.size(), StringCodec{}));
+	EXPECT_EQ(restored.getResult(), original.getResult());
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler.h"
+#include "reservoir_sampler_sharded.h"
+#include "reservoir_sampler_weighted.h"
+
+namespace
+{
+	constexpr size_t ShardsCount = 4;
+	constexpr int ElementsPerShard = 100000;
+
+	template<typename Sharded, typename SampleFn>
+	void runWorkers(Sharded& sharded, SampleFn sample)
+	{
+		std::vector<std::thread> threads;
+		for (size_t shard = 0; shard < ShardsCount; ++shard)
+		{
+			threads.emplace_back([&sharded, &sample, shard] {
+				for (int i = 0; i < ElementsPerShard; ++i)
+				{
+					sample(sharded, shard, static_cast<int>(shard)*ElementsPerShard + i);
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	template<typename Sampler>
+	void checkSnapshot(const Sampler& snapshot, size_t samplesCount)
+	{
+		ASSERT_EQ(snapshot.getResultSize(), samplesCount);
+		std::vector<int> result(snapshot.getResult().begin(), snapshot.getResult().end());
+		std::sort(result.begin(), result.end());
+		EXPECT_EQ(std::adjacent_find(result.begin(), result.end()), result.end());
+		EXPECT_GE(result.front(), 0);
+		EXPECT_LT(result.back(), static_cast<int>(ShardsCount)*ElementsPerShard);
+	}
+}
+
+TEST(ReservoirSamplerSharded, UniformSnapshotCombinesAllShards)
+{
+	using Sampler = ReservoirSampler<int>;
+	ReservoirSamplerSharded<Sampler> sharded{ShardsCount, [](size_t shard) { return Sampler(50, std::mt19937{static_cast<uint32_t>(shard)}); }};
+
+	// the snapshots are taken while the workers are sampling
+	std::thread snapshotThread([&sharded] {
+		for (int i = 0; i < 20; ++i)
+		{
+			EXPECT_LE(sharded.getSnapshot().getResultSize(), 50u);
+		}
+	});
+	runWorkers(sharded, [](auto& s, size_t shard, int element) { s.sampleElement(shard, element); });
+	snapshotThread.join();
+
+	const ReservoirSampler<int> snapshot = sharded.getSnapshot();
+	// the elements skipped after the last considered ones are counted too
+	EXPECT_EQ(snapshot.getSeenElementsCount(), ShardsCount*ElementsPerShard);
+	checkSnapshot(snapshot, 50);
+}
+
+TEST(ReservoirSamplerSharded, WeightedSnapshotCombinesAllShards)
+{
+	using Sampler = ReservoirSamplerWeighted<int>;
+	ReservoirSamplerSharded<Sampler> sharded{ShardsCount, [](size_t shard) { return Sampler(50, std::mt19937{static_cast<uint32_t>(shard)}); }};
+
+	runWorkers(sharded, [](auto& s, size_t shard, int element) { s.sampleElement(shard, static_cast<float>(element % 5 + 1), element); });
+
+	checkSnapshot(sharded.getSnapshot(), 50);
+}
+
+TEST(ReservoirSamplerSharded, ResetClearsAllShards)
+{
+	ReservoirSamplerSharded<ReservoirSampler<int>> sharded{ShardsCount, 10};
+	runWorkers(sharded, [](auto& s, size_t shard, int element) { s.sampleElement(shard, element); });
+	sharded.reset();
+
+	EXPECT_EQ(sharded.getSnapshot().getResultSize(), 0u);
+	sharded.sampleElement(0, 7);
+	EXPECT_EQ(sharded.getResult(), std::vector<int>{7});
+}
@@ -0,0 +1,61 @@
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_weighted.h"
+#include "reservoir_sampler_weighted_static.h"
+
+namespace
+{
+	// the weights are small integers so the block sums are exact and the batch has to consider the same elements
+	template<typename WeightType>
+	std::vector<WeightType> generateWeights(size_t count)
+	{
+		std::mt19937 rand(3);
+		std::vector<WeightType> weights(count);
+		for (WeightType& weight : weights)
+		{
+			const unsigned value = rand() % 10;
+			weight = static_cast<WeightType>(value < 3 ? 0 : value);
+		}
+		return weights;
+	}
+
+	template<typename Sampler, typename WeightType>
+	void checkBatchMatchesSamplingOneByOne(Sampler& batchSampler, Sampler& sampler)
+	{
+		const std::vector<WeightType> weights = generateWeights<WeightType>(100003);
+		for (size_t i = 0; i < weights.size(); ++i)
+		{
+			sampler.sampleElement(weights[i], static_cast<int>(i));
+		}
+		batchSampler.sampleWeightedBatch(weights.data(), weights.size(), [](size_t index) { return static_cast<int>(index); });
+
+		EXPECT_EQ(std::vector<int>(batchSampler.getResult().begin(), batchSampler.getResult().end()),
+			std::vector<int>(sampler.getResult().begin(), sampler.getResult().end()));
+	}
+}
+
+TEST(ReservoirSamplerWeightedBatch, FloatMatchesSamplingOneByOne)
+{
+	ReservoirSamplerWeighted<int> batchSampler{20, std::mt19937{1}};
+	ReservoirSamplerWeighted<int> sampler{20, std::mt19937{1}};
+	checkBatchMatchesSamplingOneByOne<ReservoirSamplerWeighted<int>, float>(batchSampler, sampler);
+}
+
+TEST(ReservoirSamplerWeightedBatch, DoubleMatchesSamplingOneByOne)
+{
+	using Sampler = ReservoirSamplerWeighted<int, double>;
+	Sampler batchSampler{20, std::mt19937{1}};
+	Sampler sampler{20, std::mt19937{1}};
+	checkBatchMatchesSamplingOneByOne<Sampler, double>(batchSampler, sampler);
+}
+
+TEST(ReservoirSamplerWeightedBatch, StaticMatchesSamplingOneByOne)
+{
+	using Sampler = ReservoirSamplerWeightedStatic<int, 20, double>;
+	Sampler batchSampler{std::mt19937{1}};
+	Sampler sampler{std::mt19937{1}};
+	checkBatchMatchesSamplingOneByOne<Sampler, double>(batchSampler, sampler);
+}
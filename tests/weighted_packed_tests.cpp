@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "reservoir_sampler_heap.h"
+#include "reservoir_sampler_weighted.h"
+#include "reservoir_sampler_weighted_packed.h"
+
+namespace
+{
+	template<typename HeapPolicy>
+	void checkDistributionMatchesWeighted()
+	{
+		constexpr size_t RepeatsCount = 20000;
+		std::array<size_t, 10> packedCounts{};
+		std::array<size_t, 10> referenceCounts{};
+		for (size_t repeat = 0; repeat < RepeatsCount; ++repeat)
+		{
+			ReservoirSamplerWeightedPacked<uint32_t, float, std::mt19937, float, ReservoirSamplerNoStats, HeapPolicy> packed{5, std::mt19937{static_cast<uint32_t>(repeat)}};
+			ReservoirSamplerWeighted<uint32_t> reference{5, std::mt19937{static_cast<uint32_t>(repeat + RepeatsCount)}};
+			for (uint32_t i = 0; i < 1000; ++i)
+			{
+				const uint32_t element = i % 10;
+				const float weight = static_cast<float>(element + 1);
+				packed.sampleElement(weight, element);
+				reference.sampleElement(weight, element);
+			}
+
+			ASSERT_EQ(packed.getResultSize(), 5u);
+			for (uint32_t element : packed.consumeResult())
+			{
+				++packedCounts[element];
+			}
+			for (uint32_t element : reference.getResult())
+			{
+				++referenceCounts[element];
+			}
+		}
+
+		for (size_t i = 0; i < packedCounts.size(); ++i)
+		{
+			EXPECT_NEAR(static_cast<double>(packedCounts[i]), static_cast<double>(referenceCounts[i]), referenceCounts[i] * 0.1);
+		}
+	}
+}
+
+TEST(ReservoirSamplerWeightedPacked, DistributionMatchesReservoirSamplerWeighted)
+{
+	checkDistributionMatchesWeighted<ReservoirSamplerBinaryHeap>();
+}
+
+TEST(ReservoirSamplerWeightedPacked, DistributionWithGroupAlignedHeapMatchesReservoirSamplerWeighted)
+{
+	checkDistributionMatchesWeighted<ReservoirSamplerHeap<4, uint32_t>>();
+}
+
+TEST(ReservoirSamplerWeightedPacked, CopyAndMoveKeepTheResult)
+{
+	ReservoirSamplerWeightedPacked<uint32_t> sampler{10, std::mt19937{1}};
+	for (uint32_t i = 0; i < 1000; ++i)
+	{
+		sampler.sampleElement(static_cast<float>(i % 7 + 1), i);
+	}
+
+	ReservoirSamplerWeightedPacked<uint32_t> copy(sampler);
+	ReservoirSamplerWeightedPacked<uint32_t> moved(std::move(sampler));
+	EXPECT_EQ(sampler.getResultSize(), 0u);
+
+	std::vector<uint32_t> copyResult = copy.consumeResult();
+	std::vector<uint32_t> movedResult = moved.consumeResult();
+	EXPECT_EQ(copyResult.size(), 10u);
+	EXPECT_EQ(copyResult, movedResult);
+
+	// the moved-from sampler can be used again
+	sampler.sampleElement(1.0f, 5);
+	EXPECT_EQ(sampler.getResultElement(0), 5u);
+}